@@ -25,28 +25,71 @@ bool QueryPerformanceCounter(uint64_t* lpPerformanceCount);
 static enum ggml_type type_from_string(const char * string) {
     if (strcmp(string, "Q4_0") == 0) return GGML_TYPE_Q4_0;
     if (strcmp(string, "Q4_1") == 0) return GGML_TYPE_Q4_1;
-    if (strcmp(string, "Q4_K") == 0) return GGML_TYPE_Q4_K;
     if (strcmp(string, "Q5_0") == 0) return GGML_TYPE_Q5_0;
     if (strcmp(string, "Q5_1") == 0) return GGML_TYPE_Q5_1;
-    if (strcmp(string, "Q5_K") == 0) return GGML_TYPE_Q5_K;
     if (strcmp(string, "Q8_0") == 0) return GGML_TYPE_Q8_0;
+    if (strcmp(string, "Q2_K") == 0) return GGML_TYPE_Q2_K;
+    if (strcmp(string, "Q3_K") == 0) return GGML_TYPE_Q3_K;
+    if (strcmp(string, "Q4_K") == 0) return GGML_TYPE_Q4_K;
+    if (strcmp(string, "Q5_K") == 0) return GGML_TYPE_Q5_K;
+    if (strcmp(string, "Q6_K") == 0) return GGML_TYPE_Q6_K;
     return GGML_TYPE_COUNT;
 }
 
 int main(const int argc, const char * argv[]) {
-    if (argc != 4 || type_from_string(argv[3]) == GGML_TYPE_COUNT) {
-        fprintf(stderr, "Usage: %s INPUT_FILE OUTPUT_FILE FORMAT\n\nAvailable formats: Q4_0 Q4_1 Q5_0 Q5_1 Q8_0\n", argv[0]);
+    struct rwkv_quantize_params params = rwkv_get_default_quantize_params();
+
+    // Positional arguments, with "--imatrix FILE" taken out from anywhere after the program name.
+    const char * args[5] = { NULL };
+    int arg_count = 0;
+    bool valid = true;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--imatrix") == 0) {
+            valid = valid && i + 1 < argc;
+            params.imatrix = i + 1 < argc ? argv[++i] : NULL;
+        } else if (arg_count < 5) {
+            args[arg_count++] = argv[i];
+        } else {
+            valid = false;
+        }
+    }
+
+    if (!valid || arg_count < 3 || type_from_string(args[2]) == GGML_TYPE_COUNT || (arg_count >= 4 && atoi(args[3]) <= 0)) {
+        fprintf(
+            stderr,
+            "Usage: %s INPUT_FILE OUTPUT_FILE FORMAT [N_THREADS [POLICY]] [--imatrix IMATRIX_FILE]\n\n"
+            "Available formats: Q4_0 Q4_1 Q5_0 Q5_1 Q8_0 Q2_K Q3_K Q4_K Q5_K Q6_K\n"
+            "Matrices whose rows are not a multiple of the block size of their type (256 elements for K-quants) fall back to FORMAT,\n"
+            "or keep their type if FORMAT does not fit either.\n\n"
+            "POLICY chooses per-tensor types, for example \"ffn.key=Q4_K,att.output=Q6_K,head=Q8_0,@first:2=Q8_0,@last:2=Q8_0\"\n\n"
+            "IMATRIX_FILE is an importance matrix written by rwkv_save_imatrix or python/generate_imatrix.py;\n"
+            "it reduces quantization errors of low-bit formats like Q3_K and Q4_K\n",
+            argv[0]
+        );
 
         return EXIT_FAILURE;
     }
 
+    if (arg_count >= 4) {
+        params.n_threads = (uint32_t) atoi(args[3]);
+    }
+
+    if (arg_count >= 5) {
+        params.policy = args[4];
+    }
+
     time_t freq, start, end;
     time_calibrate(freq);
 
-    fprintf(stderr, "Quantizing...\n");
+    if (params.imatrix) {
+        fprintf(stderr, "Quantizing with %u threads and importance matrix %s...\n", (unsigned) params.n_threads, params.imatrix);
+    } else {
+        fprintf(stderr, "Quantizing with %u threads...\n", (unsigned) params.n_threads);
+    }
 
     time_measure(start);
-    bool success = rwkv_quantize_model_file(argv[1], argv[2], argv[3]);
+    bool success = rwkv_quantize_model_file_with_params(args[0], args[1], args[2], &params);
     time_measure(end);
 
     double diff = TIME_DIFF(freq, start, end);
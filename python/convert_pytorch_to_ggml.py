@@ -6,13 +6,17 @@
 import argparse
 import struct
 import torch
-from typing import Dict
+from typing import Dict, Tuple
+
+# Alignment of tensor data in file version 102.
+DATA_ALIGNMENT: int = 64
 
 def parse_args():
     parser = argparse.ArgumentParser(description='Convert an RWKV model checkpoint in PyTorch format to an rwkv.cpp compatible file')
     parser.add_argument('src_path', help='Path to PyTorch checkpoint file')
     parser.add_argument('dest_path', help='Path to rwkv.cpp checkpoint file, will be overwritten')
     parser.add_argument('data_type', help='Data type, FP16 or FP32', type=str, choices=['FP16', 'FP32', 'float16', 'float32'], default='FP16')
+    parser.add_argument('--file_version', help='File version; 101 is readable by older versions of rwkv.cpp', type=int, choices=[101, 102], default=102)
     return parser.parse_args()
 
 def get_layer_count(state_dict: Dict[str, torch.Tensor]) -> int:
@@ -25,7 +29,29 @@ def get_layer_count(state_dict: Dict[str, torch.Tensor]) -> int:
 
     return n_layer
 
-def write_state_dict(state_dict: Dict[str, torch.Tensor], dest_path: str, data_type: str) -> None:
+def align(offset: int) -> int:
+    return (offset + DATA_ALIGNMENT - 1) // DATA_ALIGNMENT * DATA_ALIGNMENT
+
+def get_tensor_header(k: str, tensor: torch.Tensor) -> bytes:
+    k_encoded: bytes = k.encode('utf-8')
+
+    header: bytes = struct.pack(
+        '=iii',
+        len(tensor.shape),
+        len(k_encoded),
+        1 if tensor.dtype == torch.float16 else 0
+    )
+
+    # Dimension order is reversed here:
+    # * PyTorch shape is (x rows, y columns)
+    # * ggml shape is (y elements in a row, x elements in a column)
+    # Both shapes represent the same tensor.
+    for dim in reversed(tensor.shape):
+        header += struct.pack('=i', dim)
+
+    return header + k_encoded
+
+def write_state_dict(state_dict: Dict[str, torch.Tensor], dest_path: str, data_type: str, file_version: int = 102) -> None:
     emb_weight: torch.Tensor = state_dict['emb.weight']
 
     n_layer: int = get_layer_count(state_dict)
@@ -67,98 +93,138 @@ def write_state_dict(state_dict: Dict[str, torch.Tensor], dest_path: str, data_t
         del state_dict[k]
         state_dict = state_dict_new
 
-    with open(dest_path, 'wb') as out_file:
-        is_FP16: bool = data_type == 'FP16' or data_type == 'float16'
+    is_FP16: bool = data_type == 'FP16' or data_type == 'float16'
+
+    if is_v6_0:
+        n_head: int = state_dict['blocks.0.att.time_faaaa'].shape[0]
+
+    def convert(k: str, tensor: torch.Tensor) -> torch.Tensor:
+        tensor = tensor.float()
+
+        if '.time_' in k:
+            tensor = tensor.squeeze()
+
+        if is_v7_0:
+            if any(s in k for s in [
+                '.w1', '.w2',
+                '.a1', '.a2',
+                '.v1', '.v2',
+                '.g1', '.g2',
+            ]):
+                tensor = tensor.transpose(0, 1)
+
+        elif is_v6_0:
+            if '.time_faaaa' in k:
+                tensor = tensor.unsqueeze(-1)
+            if '.time_maa_w1' in k or '.time_decay_w' in k:
+                tensor = tensor.transpose(0, 1)
+            if '.time_maa_w2' in k:
+                tensor = tensor.transpose(1, 2)
+            if '.time_decay' in k and '_w' not in k:
+                tensor = tensor.reshape(n_head, -1, 1)
+
+        elif is_v5_1_or_2:
+            if '.time_decay' in k:
+                if is_v5_2:
+                    tensor = torch.exp(-torch.exp(tensor)).unsqueeze(-1)
+                else:
+                    tensor = torch.exp(-torch.exp(tensor)).reshape(-1, 1, 1)
+
+            if '.time_first' in k:
+                tensor = torch.exp(tensor).reshape(-1, 1, 1)
+
+            if '.time_faaaa' in k:
+                tensor = tensor.unsqueeze(-1)
+        else:
+            if '.time_decay' in k:
+                tensor = -torch.exp(tensor)
+
+        # Keep 1-dim vectors and small matrices in FP32
+        if is_FP16 and len(tensor.shape) > 1 and all(
+            s not in k for s in [
+                '.time_',
+                '.k_k', '.k_a', '.r_k',
+                '.x_rwkvag', '.x_k',
+                '.w0', '.a0', '.v0',
+            ]
+        ):
+            tensor = tensor.half()
+
+        return tensor
+
+    # Shapes and types of converted tensors, in the order they are written.
+    # Converting on the meta device computes them without touching tensor data, so only one converted tensor is in memory at a time.
+    layouts: Dict[str, torch.Tensor] = {k: convert(k, state_dict[k].to('meta')) for k in state_dict.keys()}
+
+    # Head count is the outermost dimension of these tensors, the same way rwkv.cpp infers it for older file versions.
+    if is_v7_0:
+        arch_version: Tuple[int, int] = (7, 0)
+        n_head = layouts['blocks.0.att.r_k'].shape[0]
+    elif is_v6_0:
+        arch_version = (6, 0)
+        n_head = layouts['blocks.0.att.time_decay'].shape[0]
+    elif is_v5_1_or_2:
+        arch_version = (5, 2 if is_v5_2 else 1)
+        n_head = layouts['blocks.0.att.time_decay'].shape[0]
+    else:
+        arch_version = (4, 0)
+        n_head = 0
+
+    head_size: int = n_embed // n_head if n_head > 0 else 0
 
+    def write_tensor_data(k: str, out_file) -> None:
+        tensor: torch.Tensor = convert(k, state_dict[k])
+
+        print(f'Writing {k}, shape {tensor.shape}, type {tensor.dtype}')
+
+        tensor.detach().numpy().tofile(out_file)
+
+    with open(dest_path, 'wb') as out_file:
         out_file.write(struct.pack(
             # Disable padding with '='
             '=iiiiii',
             # Magic: 'ggmf' in hex
             0x67676d66,
-            101,
+            file_version,
             n_vocab,
             n_embed,
             n_layer,
             1 if is_FP16 else 0
         ))
 
-        if is_v6_0:
-            n_head: int = state_dict['blocks.0.att.time_faaaa'].shape[0]
-        for k in state_dict.keys():
-            tensor: torch.Tensor = state_dict[k].float()
-
-            if '.time_' in k:
-                tensor = tensor.squeeze()
-
-            if is_v7_0:
-                if any(s in k for s in [
-                    '.w1', '.w2',
-                    '.a1', '.a2',
-                    '.v1', '.v2',
-                    '.g1', '.g2',
-                ]):
-                    tensor = tensor.transpose(0, 1)
-
-            elif is_v6_0:
-                if '.time_faaaa' in k:
-                    tensor = tensor.unsqueeze(-1)
-                if '.time_maa_w1' in k or '.time_decay_w' in k:
-                    tensor = tensor.transpose(0, 1)
-                if '.time_maa_w2' in k:
-                    tensor = tensor.transpose(1, 2)
-                if '.time_decay' in k and '_w' not in k:
-                    tensor = tensor.reshape(n_head, -1, 1)
-
-            elif is_v5_1_or_2:
-                if '.time_decay' in k:
-                    if is_v5_2:
-                        tensor = torch.exp(-torch.exp(tensor)).unsqueeze(-1)
-                    else:
-                        tensor = torch.exp(-torch.exp(tensor)).reshape(-1, 1, 1)
-
-                if '.time_first' in k:
-                    tensor = torch.exp(tensor).reshape(-1, 1, 1)
-
-                if '.time_faaaa' in k:
-                    tensor = tensor.unsqueeze(-1)
-            else:
-                if '.time_decay' in k:
-                    tensor = -torch.exp(tensor)
-
-            # Keep 1-dim vectors and small matrices in FP32
-            if is_FP16 and len(tensor.shape) > 1 and all(
-                s not in k for s in [
-                    '.time_',
-                    '.k_k', '.k_a', '.r_k',
-                    '.x_rwkvag', '.x_k',
-                    '.w0', '.a0', '.v0',
-                ]
-            ):
-                tensor = tensor.half()
-
-            shape = tensor.shape
+        if file_version >= 102:
+            out_file.write(struct.pack(
+                '=IIIIII',
+                arch_version[0],
+                arch_version[1],
+                head_size,
+                n_head,
+                len(layouts),
+                DATA_ALIGNMENT
+            ))
 
-            print(f'Writing {k}, shape {shape}, type {tensor.dtype}')
+            # Tensor data goes after the index, each tensor at an aligned offset.
+            offset: int = out_file.tell() + sum(len(get_tensor_header(k, t)) + 8 for k, t in layouts.items())
+            offsets: Dict[str, int] = {}
 
-            k_encoded: bytes = k.encode('utf-8')
+            for k, layout in layouts.items():
+                offset = align(offset)
+                offsets[k] = offset
+                offset += layout.numel() * layout.element_size()
 
-            out_file.write(struct.pack(
-                '=iii',
-                len(shape),
-                len(k_encoded),
-                1 if tensor.dtype == torch.float16 else 0
-            ))
+            for k, layout in layouts.items():
+                out_file.write(get_tensor_header(k, layout))
+                out_file.write(struct.pack('=Q', offsets[k]))
 
-            # Dimension order is reversed here:
-            # * PyTorch shape is (x rows, y columns)
-            # * ggml shape is (y elements in a row, x elements in a column)
-            # Both shapes represent the same tensor.
-            for dim in reversed(tensor.shape):
-                out_file.write(struct.pack('=i', dim))
+            for k in layouts.keys():
+                out_file.write(bytes(offsets[k] - out_file.tell()))
 
-            out_file.write(k_encoded)
+                write_tensor_data(k, out_file)
+        else:
+            for k, layout in layouts.items():
+                out_file.write(get_tensor_header(k, layout))
 
-            tensor.detach().numpy().tofile(out_file)
+                write_tensor_data(k, out_file)
 
 def main() -> None:
     args = parse_args()
@@ -167,7 +233,7 @@ def main() -> None:
 
     state_dict: Dict[str, torch.Tensor] = torch.load(args.src_path, map_location='cpu')
 
-    write_state_dict(state_dict, args.dest_path, args.data_type)
+    write_state_dict(state_dict, args.dest_path, args.data_type, args.file_version)
 
     print('Done')
 
@@ -13,7 +13,7 @@ def test() -> None:
             'blocks.0.ln1.weight': torch.tensor([1], dtype=torch.float32)
         }
 
-        convert_pytorch_to_ggml.write_state_dict(state_dict, dest_path=test_file_path, data_type='FP32')
+        convert_pytorch_to_ggml.write_state_dict(state_dict, dest_path=test_file_path, data_type='FP32', file_version=101)
 
         with open(test_file_path, 'rb') as test_file:
             actual_bytes: bytes = test_file.read()
@@ -45,6 +45,49 @@ def test() -> None:
 
         assert list(actual_bytes) == list(expected_bytes), f'\nActual: {list(actual_bytes)}\nExpected: {list(expected_bytes)}'
 
+        convert_pytorch_to_ggml.write_state_dict(state_dict, dest_path=test_file_path, data_type='FP32', file_version=102)
+
+        with open(test_file_path, 'rb') as test_file:
+            actual_bytes: bytes = test_file.read()
+
+        # Index takes 129 bytes, so tensor data starts at offset 192, and the next tensor at offset 256.
+        expected_bytes: bytes = struct.pack(
+            '=iiiiii' + 'IIIIII' + 'iiiii10sQ' + 'iiii19sQ' + '63x' + 'ffffff' + '40x' + 'f',
+            0x67676d66,
+            102,
+            3,
+            2,
+            1,
+            0,
+            # Metadata: v4 has no heads
+            4,
+            0,
+            0,
+            0,
+            2,
+            64,
+            # emb.weight
+            2,
+            10,
+            0,
+            2, 3,
+            'emb.weight'.encode('utf-8'),
+            192,
+            # blocks.0.ln1.weight
+            1,
+            19,
+            0,
+            1,
+            'blocks.0.ln1.weight'.encode('utf-8'),
+            256,
+            # Data
+            1.0, 2.0, 3.0,
+            4.0, 5.0, 6.0,
+            1.0
+        )
+
+        assert list(actual_bytes) == list(expected_bytes), f'\nActual: {list(actual_bytes)}\nExpected: {list(expected_bytes)}'
+
         print('All tests pass')
     finally:
         if os.path.isfile(test_file_path):
@@ -0,0 +1,65 @@
+# Collects an importance matrix of an RWKV model on a given text file, for use with quantize.py --imatrix.
+# Low-bit formats like Q3_K and Q4_K lose much less quality when quantized with an importance matrix.
+# Usage: python generate_imatrix.py C:\rwkv.cpp-169M-FP16.bin C:\text.txt C:\rwkv.cpp-169M.imatrix
+
+import time
+import argparse
+from rwkv_cpp import rwkv_cpp_shared_library, rwkv_cpp_model
+from tokenizer_util import add_tokenizer_argument, get_tokenizer
+from typing import List
+
+def parse_args():
+    parser = argparse.ArgumentParser(description='Collect an importance matrix of an RWKV model on a given text file')
+    parser.add_argument('model_path', help='Path to FP32/FP16 model checkpoint file', type=str)
+    parser.add_argument('text_path', help='Path to calibration text file in UTF-8 encoding', type=str)
+    parser.add_argument('imatrix_path', help='Path to resulting importance matrix file, will be overwritten', type=str)
+    add_tokenizer_argument(parser)
+    parser.add_argument('--token_limit', help='How many tokens to process; set to -1 to process all text', type=int, default=-1)
+    parser.add_argument('--sequence_length', help='Length of sequences evaluated from the initial state', type=int, default=512)
+    parser.add_argument('--chunk_size', help='Size of chunks passed to eval_sequence', type=int, default=16)
+    return parser.parse_args()
+
+def main() -> None:
+    args = parse_args()
+
+    print('Loading model')
+    model: rwkv_cpp_model.RWKVModel = rwkv_cpp_model.RWKVModel(
+        rwkv_cpp_shared_library.load_rwkv_shared_library(),
+        args.model_path
+    )
+
+    print('Loading text')
+    text: str = open(args.text_path, encoding='utf-8').read()
+
+    _, tokenizer_encode = get_tokenizer(args.tokenizer, model.n_vocab)
+
+    tokens: List[int] = tokenizer_encode(text)
+
+    if args.token_limit != -1:
+        tokens = tokens[:args.token_limit]
+
+    token_count: int = len(tokens)
+    print(f'{token_count} tokens in the text')
+
+    if token_count == 0:
+        raise ValueError('Need at least 1 token for calibration')
+
+    model.start_imatrix_collection()
+
+    start: float = time.time()
+
+    # The state is reset for each sequence, so that statistics cover activations of both fresh and long contexts.
+    for i in range(0, token_count, args.sequence_length):
+        model.eval_sequence_in_chunks(tokens[i:i + args.sequence_length], None, chunk_size=args.chunk_size, use_numpy=True)
+
+        done: int = min(i + args.sequence_length, token_count)
+        print(f'{done}/{token_count} tokens, {int((time.time() - start) * 1000 / done)} ms per token')
+
+    model.save_imatrix(args.imatrix_path)
+
+    model.free()
+
+    print('Done')
+
+if __name__ == "__main__":
+    main()
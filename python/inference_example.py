@@ -2,7 +2,6 @@
 # Usage example: python inference_example.py C:\rwkv.cpp-169M-Q5_1.bin 20B
 
 import argparse
-import sampling
 from rwkv_cpp import rwkv_cpp_shared_library, rwkv_cpp_model
 from tokenizer_util import add_tokenizer_argument, get_tokenizer
 from typing import List
@@ -28,15 +27,19 @@ prompt_tokens: List[int] = tokenizer_encode(prompt)
 # Process the prompt.
 logits, state = model.eval_sequence_in_chunks(prompt_tokens, None, None, None, use_numpy=True)
 
+# Sampling runs in native code; sampling.sample_logits does the same in NumPy.
+sampler = model.create_sampler(temperature=0.8, top_p=0.5)
+
 # Generate and print the completion.
 print(prompt, end='')
 
 for i in range(32):
-    token: int = sampling.sample_logits(logits, temperature=0.8, top_p=0.5)
+    token: int = sampler.sample(logits)
 
     print(tokenizer_decode([token]), end='', flush=True)
 
     logits, state = model.eval(token, state, state, logits, use_numpy=True)
 
 # Don't forget to free the memory after you are done working with the model!
+sampler.free()
 model.free()
@@ -3,10 +3,9 @@
 # Usage: python measure_pexplexity.py C:\rwkv.cpp-169M.bin C:\text.txt 1024
 
 import os
+import math
 import time
 import argparse
-# TODO Get rid of this PyTorch dependency by writing a cross_entropy impl for numpy
-import torch
 from rwkv_cpp import rwkv_cpp_shared_library, rwkv_cpp_model
 from tokenizer_util import add_tokenizer_argument, get_tokenizer
 from typing import List
@@ -17,6 +16,7 @@ def parse_args():
     parser.add_argument('text_path', help='Path to text file in UTF-8 encoding', type=str)
     parser.add_argument('ignore_first_n_tokens', help='How many tokens should be skipped before loss is measured', type=int)
     parser.add_argument('token_limit', help='How many tokens to process; set to -1 to process all text', nargs='?', type=int, default=-1)
+    parser.add_argument('--chunk_size', help='How many tokens to evaluate at once; logits of a chunk are computed by a single matrix multiplication', type=int, default=32)
     add_tokenizer_argument(parser)
     return parser.parse_args()
 
@@ -53,53 +53,55 @@ if not (token_count - args.ignore_first_n_tokens > 1):
 
 # ---
 
-def format_loss(loss: torch.Tensor) -> str:
-    return str(['%.3f' % (loss[i].item(),) for i in range(len(loss))]).replace('\'', '')[1:-1]
-
-def format_loss_with_perplexity(loss: torch.Tensor) -> str:
-    return f'loss [{format_loss(loss)}], perplexity {"%.3f" % (torch.exp(loss[0]).item(),)}'
+def format_loss_with_perplexity(loss: float) -> str:
+    return f'loss [{"%.3f" % (loss,)}], perplexity {"%.3f" % (math.exp(loss),)}'
 
 # ---
 
-logits, state = None, None
+state = None
 
-loss_sum: torch.Tensor = torch.tensor([0.0])
+loss_sum: float = 0.0
 loss_count: int = 0
 
 start: float = time.time()
 
 run_count: int = token_count - 1
 
-for i in range(run_count):
-    token: int = tokens[i]
-    target: int = tokens[i + 1]
-
-    logits, state = model.eval(token, state, state, logits)
-
-    if args.ignore_first_n_tokens == 0 or i + 1 >= args.ignore_first_n_tokens:
-        losses = torch.tensor([
-            torch.nn.functional.cross_entropy(logits, torch.tensor(target, dtype=torch.long), reduction='none').item()
-        ])
-
-        loss_sum += losses
-        loss_count += 1
-
-    if run_count <= 5 or i % (run_count // 10) == 0:
-        avg_loss_so_far = loss_sum / loss_count
-
-        duration: float = time.time() - start
-        duration_per_token: float = duration / (i + 1)
-        runs_remaining: int = run_count - i - 1
-        duration_remaining: int = int(runs_remaining * duration_per_token)
-
-        print(f'Token #{i}/{token_count}, '
-              f'{int(100.0 * i / token_count)}%, '
-              f'ETA {duration_remaining // 60} m {duration_remaining % 60} s', end='')
-
-        if loss_count > 0:
-            print(f', averages so far: {format_loss_with_perplexity(avg_loss_so_far)}')
-        else:
-            print()
+# Tokens are evaluated in blocks to report progress; within a block, logits are computed chunk by chunk in sequence mode.
+block_size: int = max(run_count // 10, 1)
+
+for block_start in range(0, run_count, block_size):
+    block_end: int = min(block_start + block_size, run_count)
+
+    log_probs, state = model.eval_sequence_log_probs(
+        tokens[block_start:block_end],
+        tokens[block_start + 1:block_end + 1],
+        state,
+        state,
+        chunk_size=args.chunk_size,
+        use_numpy=True
+    )
+
+    for i in range(block_start, block_end):
+        if args.ignore_first_n_tokens == 0 or i + 1 >= args.ignore_first_n_tokens:
+            loss_sum += -float(log_probs[i - block_start])
+            loss_count += 1
+
+    i = block_end - 1
+
+    duration: float = time.time() - start
+    duration_per_token: float = duration / (i + 1)
+    runs_remaining: int = run_count - i - 1
+    duration_remaining: int = int(runs_remaining * duration_per_token)
+
+    print(f'Token #{i}/{token_count}, '
+          f'{int(100.0 * i / token_count)}%, '
+          f'ETA {duration_remaining // 60} m {duration_remaining % 60} s', end='')
+
+    if loss_count > 0:
+        print(f', averages so far: {format_loss_with_perplexity(loss_sum / loss_count)}')
+    else:
+        print()
 
 print()
 print(f'Model: {os.path.basename(args.model_path)}, '
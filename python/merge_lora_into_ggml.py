@@ -8,7 +8,7 @@ import argparse
 import struct
 import torch
 import numpy as np
-from typing import List, Dict, Tuple
+from typing import List, Dict, Tuple, Iterator
 
 def parse_args():
     parser = argparse.ArgumentParser(description='Merge a PyTorch LoRA checkpoint (.pth) into an rwkv.cpp model file')
@@ -42,6 +42,46 @@ def write_parameter(out_file, key: str, parameter: torch.Tensor) -> None:
 
     parameter.numpy().tofile(out_file)
 
+def read_parameter_header(in_file) -> Tuple[str, int, List[int]]:
+    dim_count, key_length, data_type = struct.unpack('=iii', in_file.read(3 * 4))
+
+    # noinspection PyTypeChecker
+    shape: Tuple[int] = struct.unpack('=' + 'i' * dim_count, in_file.read(dim_count * 4))
+    # ggml order to PyTorch
+    shape: List[int] = [d for d in reversed(shape)]
+
+    key: str = in_file.read(key_length).decode('utf-8')
+
+    return key, data_type, shape
+
+def read_parameters(in_file, version: int) -> Iterator[Tuple[str, int, List[int], int]]:
+    """
+    Yields key, data type, shape and data offset of each parameter of the model file.
+    The file must be positioned right after the file header.
+    """
+
+    if version >= 102:
+        # Architecture metadata is followed by the tensor index.
+        _, _, _, _, tensor_count, _ = struct.unpack('=IIIIII', in_file.read(6 * 4))
+
+        index: List[Tuple[str, int, List[int], int]] = []
+
+        for _ in range(tensor_count):
+            key, data_type, shape = read_parameter_header(in_file)
+            offset, = struct.unpack('=Q', in_file.read(8))
+            index.append((key, data_type, shape, offset))
+
+        yield from index
+    else:
+        while True:
+            if len(in_file.peek(1)) == 0:
+                break
+
+            key, data_type, shape = read_parameter_header(in_file)
+            offset: int = in_file.tell()
+
+            yield key, data_type, shape, offset
+
 def main() -> None:
     args = parse_args()
 
@@ -62,28 +102,15 @@ def main() -> None:
 
         if header[0] != 0x67676d66:
             raise ValueError(f'Invalid magic value {header[0]:x}')
-        if not (100 <= header[1] <= 101):
+        if not (100 <= header[1] <= 102):
             raise ValueError(f'Invalid version number {header[1]}')
         if not (header[5] == 0 or header[5] == 1):
             raise ValueError('Only FP32 and FP16 models are supported')
 
-        out_file.write(struct.pack('=iiiiii', *header))
-
-        while True:
-            parameter_header_bytes: bytes = in_file.read(3 * 4)
-
-            if len(parameter_header_bytes) == 0:
-                break
-
-            dim_count, key_length, data_type = struct.unpack('=iii', parameter_header_bytes)
-
-            # noinspection PyTypeChecker
-            shape: Tuple[int] = struct.unpack('=' + 'i' * dim_count, in_file.read(dim_count * 4))
-            # ggml order to PyTorch
-            shape: List[int] = [d for d in reversed(shape)]
-
-            key: str = in_file.read(key_length).decode('utf-8')
+        # Parameters are written sequentially, without the tensor index, so the output has version 101.
+        out_file.write(struct.pack('=iiiiii', header[0], min(header[1], 101), *header[2:]))
 
+        for key, data_type, shape, offset in read_parameters(in_file, header[1]):
             print(f'* {key} {shape}')
 
             if not (data_type == 0 or data_type == 1):
@@ -94,6 +121,8 @@ def main() -> None:
             for dim in shape:
                 element_count *= dim
 
+            in_file.seek(offset)
+
             parameter_np: np.ndarray = np.frombuffer(
                 in_file.read((2 if data_type == 1 else 4) * element_count),
                 dtype=(np.half if data_type == 1 else np.single)
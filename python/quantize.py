@@ -12,6 +12,9 @@ def parse_args():
     parser.add_argument('src_path', help='Path to FP32/FP16 checkpoint file')
     parser.add_argument('dest_path', help='Path to resulting checkpoint file, will be overwritten')
     parser.add_argument('format_name', help='Format name, one of ' + ', '.join(format_names), type=str, choices=format_names, default='Q5_1')
+    parser.add_argument('--thread_count', help='Count of threads quantizing each matrix', type=int, default=1)
+    parser.add_argument('--policy', help='Per-tensor data types, like "ffn.key=Q4_K,head=Q8_0,@last:2=Q8_0"', type=str, default=None)
+    parser.add_argument('--imatrix', help='Path to an importance matrix file created by generate_imatrix.py', type=str, default=None)
     return parser.parse_args()
 
 def main() -> None:
@@ -22,7 +25,10 @@ def main() -> None:
     library.rwkv_quantize_model_file(
         args.src_path,
         args.dest_path,
-        args.format_name
+        args.format_name,
+        args.thread_count,
+        args.policy,
+        args.imatrix
     )
 
     print('Done')
@@ -14,7 +14,7 @@ try:
 except ModuleNotFoundError:
     from . import rwkv_cpp_shared_library
 
-from typing import TypeVar, Optional, Tuple, List
+from typing import TypeVar, Optional, Tuple, List, Dict
 
 # A value of this type is either a numpy's ndarray or a PyTorch's Tensor.
 NumpyArrayOrPyTorchTensor: TypeVar = TypeVar('NumpyArrayOrPyTorchTensor')
@@ -238,7 +238,7 @@ class RWKVModel:
 
         Chunking allows processing sequences of thousands of tokens, while not reaching the ggml's node limit and not consuming too much memory.
         A reasonable and recommended value of chunk size is 16. If you want maximum performance, try different chunk sizes in range [2..64]
-        and choose one that works the best in your use case.
+        and choose one that works the best in your use case, or let auto_tune choose one and pass 0.
 
         In case of any error, this method will throw an exception.
 
@@ -247,7 +247,7 @@ class RWKVModel:
         tokens : List[int]
             Indices of the next tokens to be seen by the model. Must be in range 0 <= token < n_vocab.
         chunk_size : int
-            Size of each chunk in tokens, must be positive.
+            Size of each chunk in tokens, 0 means the chunk size chosen by auto_tune, or 16 if the model was not tuned.
         state_in : Optional[NumpyArrayOrTorchTensor]
             State from previous call of this method. If this is a first pass, set it to None.
         state_out : Optional[NumpyArrayOrTorchTensor]
@@ -298,6 +298,238 @@ class RWKVModel:
 
         return logits_out, state_out
 
+    def eval_sequence_log_probs(
+            self,
+            tokens: List[int],
+            targets: List[int],
+            state_in: Optional[NumpyArrayOrPyTorchTensor],
+            state_out: Optional[NumpyArrayOrPyTorchTensor] = None,
+            chunk_size: int = 16,
+            use_numpy: bool = False
+    ) -> Tuple[NumpyArrayOrPyTorchTensor, NumpyArrayOrPyTorchTensor]:
+        """
+        Evaluates the model for a sequence of tokens and returns log-probabilities of the target tokens, one per token.
+        Logits of all tokens of a chunk are computed at once, which is much faster than calling `eval` for each token
+        when scoring continuations or measuring perplexity. Memory use is bounded by the chunk size.
+
+        In case of any error, this method will throw an exception.
+
+        Parameters
+        ----------
+        tokens : List[int]
+            Indices of the next tokens to be seen by the model. Must be in range 0 <= token < n_vocab.
+        targets : List[int]
+            Indices of the tokens to score, one per token; log_probs[i] is the log-probability of targets[i] after tokens[i].
+            Usually tokens shifted by one. Must be in range 0 <= token < n_vocab.
+        state_in : Optional[NumpyArrayOrTorchTensor]
+            State from previous call of this method. If this is a first pass, set it to None.
+        state_out : Optional[NumpyArrayOrTorchTensor]
+            Optional output tensor for state. If provided, must be of type float32, contiguous and of shape (state_buffer_element_count).
+        chunk_size : int
+            Size of each chunk in tokens, must be positive.
+        use_numpy : bool
+            If set to True, numpy's ndarrays will be created instead of PyTorch's Tensors.
+            This parameter is ignored if any tensor parameter is not None; in such case,
+            type of returned tensors will match the type of received tensors.
+
+        Returns
+        -------
+        log_probs, state
+            Vector of natural logarithms of target probabilities of shape (len(tokens)); state for the next step.
+        """
+
+        if not self._valid:
+            raise ValueError('Model was freed')
+
+        use_numpy = self._detect_numpy_usage([state_in, state_out], use_numpy)
+
+        if state_in is not None:
+            self._validate_tensor(state_in, 'state_in', self._state_buffer_element_count)
+
+            state_in_ptr = self._get_data_ptr(state_in)
+        else:
+            state_in_ptr = 0
+
+        if state_out is not None:
+            self._validate_tensor(state_out, 'state_out', self._state_buffer_element_count)
+        else:
+            state_out = self._zeros_float32(self._state_buffer_element_count, use_numpy)
+
+        log_probs_out = self._zeros_float32(len(tokens), use_numpy)
+
+        self._library.rwkv_eval_sequence_log_probs(
+            self._ctx,
+            tokens,
+            targets,
+            chunk_size,
+            state_in_ptr,
+            self._get_data_ptr(state_out),
+            self._get_data_ptr(log_probs_out)
+        )
+
+        return log_probs_out, state_out
+
+    def set_thread_count(self, serial_thread_count: int = 0, sequence_thread_count: int = 0) -> None:
+        """
+        Overrides the thread count of following evaluations; it can be changed between calls at no cost.
+
+        Parameters
+        ----------
+        serial_thread_count : int
+            Threads of evaluations of single tokens; 0 means the thread count the model was loaded with.
+        sequence_thread_count : int
+            Threads of evaluations of sequences of several tokens; 0 means the thread count the model was loaded with.
+        """
+
+        if not self._valid:
+            raise ValueError('Model was freed')
+
+        self._library.rwkv_set_n_threads(self._ctx, serial_thread_count, sequence_thread_count)
+
+    def auto_tune(self, max_thread_count: int = 0) -> Tuple[int, int, int]:
+        """
+        Measures evaluation speed with several chunk sizes and thread counts, and keeps the fastest ones:
+        thread counts are set like with set_thread_count, and eval_sequence_in_chunks uses the chunk size when given 0.
+        Takes roughly as long as evaluating a few thousand tokens.
+        In case of any error, this method will throw an exception.
+
+        Parameters
+        ----------
+        max_thread_count : int
+            Largest thread count to try; 0 means the count of hardware threads.
+
+        Returns
+        -------
+        chunk_size, serial_thread_count, sequence_thread_count
+            The fastest chunk size and thread counts.
+        """
+
+        if not self._valid:
+            raise ValueError('Model was freed')
+
+        return self._library.rwkv_auto_tune(self._ctx, max_thread_count)
+
+    def start_imatrix_collection(self) -> None:
+        """
+        Starts collecting an importance matrix for quantization from all following evaluations.
+        Calling this method again discards already collected statistics.
+        In case of any error, this method will throw an exception.
+        """
+
+        if not self._valid:
+            raise ValueError('Model was freed')
+
+        self._library.rwkv_start_imatrix_collection(self._ctx)
+
+    def save_imatrix(self, file_path: str) -> None:
+        """
+        Writes the collected importance matrix to a file, which can be passed to rwkv_quantize_model_file.
+        In case of any error, this method will throw an exception.
+
+        Parameters
+        ----------
+        file_path : str
+            Path to the file, will be overwritten.
+        """
+
+        if not self._valid:
+            raise ValueError('Model was freed')
+
+        self._library.rwkv_save_imatrix(self._ctx, file_path)
+
+    def stop_imatrix_collection(self) -> None:
+        """
+        Stops collecting the importance matrix and discards collected statistics.
+        """
+
+        if not self._valid:
+            raise ValueError('Model was freed')
+
+        self._library.rwkv_stop_imatrix_collection(self._ctx)
+
+    def create_sampler(self, **kwargs) -> 'RWKVSampler':
+        """
+        Creates a native sampler for logits of this model, which is much faster than sampling.py for large vocabularies.
+        Keyword arguments are sampling parameters: temperature, top_k, top_p, min_p, repetition_penalty,
+        presence_penalty, frequency_penalty, penalty_last_n and seed; see RWKVSharedLibrary.rwkv_create_sampler.
+        In case of any error, this method will throw an exception.
+        """
+
+        if not self._valid:
+            raise ValueError('Model was freed')
+
+        return RWKVSampler(self, self._library.rwkv_create_sampler(self._ctx, **kwargs))
+
+    def create_speculative_decoder(self, draft_model: 'RWKVModel', draft_length: int = 4) -> 'RWKVSpeculativeDecoder':
+        """
+        Creates a speculative decoder that generates tokens of this model faster by letting a small draft model with the same vocabulary propose them.
+        Both models must outlive the decoder.
+        In case of any error, this method will throw an exception.
+
+        Parameters
+        ----------
+        draft_model : RWKVModel
+            Draft model, usually much smaller than this model.
+        draft_length : int
+            Count of tokens the draft model proposes per round, must be positive.
+        """
+
+        if not self._valid or not draft_model._valid:
+            raise ValueError('Model was freed')
+
+        return RWKVSpeculativeDecoder(self, self._library.rwkv_create_speculative_decoder(self._ctx, draft_model._ctx, draft_length))
+
+    def beam_search(
+            self,
+            prompt: List[int],
+            state_in: Optional[NumpyArrayOrPyTorchTensor] = None,
+            beam_width: int = 4,
+            max_tokens: int = 32,
+            length_penalty: float = 1.0,
+            end_token: int = -1
+    ) -> List[Tuple[List[int], float, float]]:
+        """
+        Finds the most likely continuations of the prompt with beam search. All live beams are evaluated in one batch per token.
+        In case of any error, this method will throw an exception.
+
+        Parameters
+        ----------
+        prompt : List[int]
+            Prompt token indices, in range 0 <= token < n_vocab. Must not be empty.
+        state_in : Optional[NumpyArrayOrTorchTensor]
+            State before the prompt. If this is a first pass, set it to None.
+        beam_width : int
+            Count of live beams and of returned results.
+        max_tokens : int
+            Count of generated tokens after which a beam ends.
+        length_penalty : float
+            Exponent of the length that log-probabilities of results are divided by; 0 ranks by log-probability alone.
+        end_token : int
+            Token that ends a beam, or -1.
+
+        Returns
+        -------
+        results
+            Tuples of generated tokens, their log-probability and the score, the best result first.
+        """
+
+        if not self._valid:
+            raise ValueError('Model was freed')
+
+        if state_in is not None:
+            self._validate_tensor(state_in, 'state_in', self._state_buffer_element_count)
+
+            state_in_ptr = self._get_data_ptr(state_in)
+        else:
+            state_in_ptr = 0
+
+        search = self._library.rwkv_create_beam_search(self._ctx, beam_width, max_tokens, length_penalty, end_token)
+
+        try:
+            return self._library.rwkv_beam_search(search, prompt, state_in_ptr)
+        finally:
+            self._library.rwkv_free_beam_search(search)
+
     def free(self) -> None:
         """
         Frees all allocated resources.
@@ -362,3 +594,171 @@ class RWKVModel:
             return np.zeros(element_count, dtype=np.float32)
         else:
             return torch.zeros(element_count, dtype=torch.float32, device='cpu')
+
+class RWKVSampler:
+    """
+    Samples tokens from logits of an RWKVModel in native code. Create it with RWKVModel.create_sampler.
+    """
+
+    def __init__(self, model: RWKVModel, sampler: rwkv_cpp_shared_library.RWKVSampler) -> None:
+        self._model: RWKVModel = model
+        self._library: rwkv_cpp_shared_library.RWKVSharedLibrary = model._library
+        self._sampler: rwkv_cpp_shared_library.RWKVSampler = sampler
+
+        self._valid: bool = True
+
+    def sample(self, logits: NumpyArrayOrPyTorchTensor) -> int:
+        """
+        Samples a token from logits returned by RWKVModel.eval and similar methods, and adds it to the history for penalties.
+
+        Parameters
+        ----------
+        logits : NumpyArrayOrTorchTensor
+            Logits of shape (n_vocab), of type float32 and contiguous. They are not modified.
+        """
+
+        if not self._valid:
+            raise ValueError('Sampler was freed')
+
+        self._model._validate_tensor(logits, 'logits', self._model._logits_buffer_element_count)
+
+        return self._library.rwkv_sampler_sample(self._sampler, self._model._get_data_ptr(logits))
+
+    def accept(self, token: int) -> None:
+        """
+        Adds a token to the history that penalties apply to; use it for prompt tokens.
+        """
+
+        if not self._valid:
+            raise ValueError('Sampler was freed')
+
+        self._library.rwkv_sampler_accept(self._sampler, token)
+
+    def set_logit_bias(self, logit_bias: Dict[int, float]) -> None:
+        """
+        Replaces the logit bias. A bias of float('-inf') bans the token; an empty dict removes the bias.
+        """
+
+        if not self._valid:
+            raise ValueError('Sampler was freed')
+
+        self._library.rwkv_sampler_set_logit_bias(self._sampler, logit_bias)
+
+    def reset(self) -> None:
+        """
+        Clears the history and reseeds the random number generator.
+        """
+
+        if not self._valid:
+            raise ValueError('Sampler was freed')
+
+        self._library.rwkv_sampler_reset(self._sampler)
+
+    def free(self) -> None:
+        """
+        Frees the sampler. The object must not be used anymore after calling this method.
+        """
+
+        if not self._valid:
+            raise ValueError('Already freed')
+
+        self._valid = False
+
+        self._library.rwkv_free_sampler(self._sampler)
+
+    def __del__(self) -> None:
+        if hasattr(self, '_valid') and self._valid:
+            self.free()
+
+class RWKVSpeculativeDecoder:
+    """
+    Generates tokens of a target RWKVModel with a draft model proposing them. Create it with RWKVModel.create_speculative_decoder.
+    """
+
+    def __init__(self, model: RWKVModel, decoder: rwkv_cpp_shared_library.RWKVSpeculativeDecoder) -> None:
+        self._model: RWKVModel = model
+        self._library: rwkv_cpp_shared_library.RWKVSharedLibrary = model._library
+        self._decoder: rwkv_cpp_shared_library.RWKVSpeculativeDecoder = decoder
+
+        self._valid: bool = True
+
+    def feed(self, tokens: List[int]) -> None:
+        """
+        Evaluates tokens, like a prompt or user input, with both models.
+        """
+
+        if not self._valid:
+            raise ValueError('Decoder was freed')
+
+        self._library.rwkv_speculative_feed(self._decoder, tokens)
+
+    def decode(self, sampler: RWKVSampler, max_count: int = 64) -> List[int]:
+        """
+        Runs one round of speculative decoding and returns the emitted tokens, at least one and at most max_count.
+        The sampler is used for both models; emitted tokens are added to its history.
+        """
+
+        if not self._valid:
+            raise ValueError('Decoder was freed')
+
+        return self._library.rwkv_speculative_decode(self._decoder, sampler._sampler, max_count)
+
+    def set_draft_length(self, draft_length: int) -> None:
+        """
+        Changes the count of tokens the draft model proposes per round.
+        """
+
+        if not self._valid:
+            raise ValueError('Decoder was freed')
+
+        self._library.rwkv_set_speculative_draft_length(self._decoder, draft_length)
+
+    def reset(self) -> None:
+        """
+        Resets the states of both models. Statistics are kept.
+        """
+
+        if not self._valid:
+            raise ValueError('Decoder was freed')
+
+        self._library.rwkv_speculative_reset(self._decoder)
+
+    def stats(self) -> Dict[str, int]:
+        """
+        Returns rounds, drafted_tokens, accepted_tokens and generated_tokens counts, and acceptance_by_position,
+        counts of rounds in which the drafted token at each position was accepted.
+        """
+
+        if not self._valid:
+            raise ValueError('Decoder was freed')
+
+        stats = self._library.rwkv_get_speculative_stats(self._decoder)
+        stats['acceptance_by_position'] = self._library.rwkv_get_speculative_acceptance_by_position(self._decoder)
+
+        return stats
+
+    def reset_stats(self) -> None:
+        """
+        Resets all statistics to 0.
+        """
+
+        if not self._valid:
+            raise ValueError('Decoder was freed')
+
+        self._library.rwkv_reset_speculative_stats(self._decoder)
+
+    def free(self) -> None:
+        """
+        Frees the decoder. The object must not be used anymore after calling this method.
+        """
+
+        if not self._valid:
+            raise ValueError('Already freed')
+
+        self._valid = False
+
+        self._library.rwkv_free_speculative_decoder(self._decoder)
+
+    def __del__(self) -> None:
+        if hasattr(self, '_valid') and self._valid:
+            self.free()
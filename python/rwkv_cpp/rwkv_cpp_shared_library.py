@@ -3,15 +3,18 @@ import sys
 import ctypes
 import pathlib
 import platform
-from typing import Optional, List, Tuple, Callable
+from typing import Optional, List, Tuple, Callable, Dict
 
-QUANTIZED_FORMAT_NAMES: Tuple[str, str, str, str, str] = (
+QUANTIZED_FORMAT_NAMES: Tuple[str, ...] = (
+    'Q2_K',
+    'Q3_K',
     'Q4_0',
     'Q4_1',
     'Q4_K',
     'Q5_0',
     'Q5_1',
     'Q5_K',
+    'Q6_K',
     'Q8_0'
 )
 
@@ -23,6 +26,61 @@ class RWKVContext:
     def __init__(self, ptr: ctypes.pointer) -> None:
         self.ptr: ctypes.pointer = ptr
 
+class RWKVQuantizeParams(ctypes.Structure):
+    """
+    Mirrors struct rwkv_quantize_params from rwkv.h.
+    """
+
+    _fields_ = [
+        ('n_threads', ctypes.c_uint32),
+        ('policy', ctypes.c_char_p),
+        ('imatrix', ctypes.c_char_p)
+    ]
+
+class RWKVSampler:
+
+    def __init__(self, ptr: ctypes.pointer) -> None:
+        self.ptr: ctypes.pointer = ptr
+
+class RWKVSamplerParams(ctypes.Structure):
+    """
+    Mirrors struct rwkv_sampler_params from rwkv.h.
+    """
+
+    _fields_ = [
+        ('temperature', ctypes.c_float),
+        ('top_k', ctypes.c_uint32),
+        ('top_p', ctypes.c_float),
+        ('min_p', ctypes.c_float),
+        ('repetition_penalty', ctypes.c_float),
+        ('presence_penalty', ctypes.c_float),
+        ('frequency_penalty', ctypes.c_float),
+        ('penalty_last_n', ctypes.c_uint32),
+        ('seed', ctypes.c_uint64)
+    ]
+
+class RWKVSpeculativeDecoder:
+
+    def __init__(self, ptr: ctypes.pointer) -> None:
+        self.ptr: ctypes.pointer = ptr
+
+class RWKVBeamSearch:
+
+    def __init__(self, ptr: ctypes.pointer) -> None:
+        self.ptr: ctypes.pointer = ptr
+
+class RWKVBeamSearchParams(ctypes.Structure):
+    """
+    Mirrors struct rwkv_beam_search_params from rwkv.h.
+    """
+
+    _fields_ = [
+        ('beam_width', ctypes.c_uint32),
+        ('max_tokens', ctypes.c_uint32),
+        ('length_penalty', ctypes.c_float),
+        ('end_token', ctypes.c_int32)
+    ]
+
 class RWKVSharedLibrary:
     """
     Python wrapper around rwkv.cpp shared library.
@@ -79,6 +137,30 @@ class RWKVSharedLibrary:
         ]
         self.library.rwkv_eval_sequence_in_chunks.restype = ctypes.c_bool
 
+        self.library.rwkv_set_n_threads.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint32]
+        self.library.rwkv_set_n_threads.restype = None
+
+        self.library.rwkv_auto_tune.argtypes = [
+            ctypes.c_void_p, # ctx
+            ctypes.c_uint32, # max_threads
+            ctypes.POINTER(ctypes.c_size_t), # chunk_size_out
+            ctypes.POINTER(ctypes.c_uint32), # serial_n_threads_out
+            ctypes.POINTER(ctypes.c_uint32)  # sequence_n_threads_out
+        ]
+        self.library.rwkv_auto_tune.restype = ctypes.c_bool
+
+        self.library.rwkv_eval_sequence_log_probs.argtypes = [
+            ctypes.c_void_p, # ctx
+            P_INT, # tokens
+            P_INT, # targets
+            ctypes.c_size_t, # token count
+            ctypes.c_size_t, # chunk size
+            P_FLOAT, # state_in
+            P_FLOAT, # state_out
+            P_FLOAT  # log_probs_out
+        ]
+        self.library.rwkv_eval_sequence_log_probs.restype = ctypes.c_bool
+
         self.library.rwkv_get_n_vocab.argtypes = [ctypes.c_void_p]
         self.library.rwkv_get_n_vocab.restype = ctypes.c_size_t
 
@@ -100,9 +182,118 @@ class RWKVSharedLibrary:
         self.library.rwkv_free.argtypes = [ctypes.c_void_p]
         self.library.rwkv_free.restype = None
 
+        self.library.rwkv_start_imatrix_collection.argtypes = [ctypes.c_void_p]
+        self.library.rwkv_start_imatrix_collection.restype = ctypes.c_bool
+
+        self.library.rwkv_save_imatrix.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+        self.library.rwkv_save_imatrix.restype = ctypes.c_bool
+
+        self.library.rwkv_stop_imatrix_collection.argtypes = [ctypes.c_void_p]
+        self.library.rwkv_stop_imatrix_collection.restype = None
+
         self.library.rwkv_quantize_model_file.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p]
         self.library.rwkv_quantize_model_file.restype = ctypes.c_bool
 
+        self.library.rwkv_get_default_quantize_params.argtypes = []
+        self.library.rwkv_get_default_quantize_params.restype = RWKVQuantizeParams
+
+        self.library.rwkv_quantize_model_file_with_params.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.POINTER(RWKVQuantizeParams)]
+        self.library.rwkv_quantize_model_file_with_params.restype = ctypes.c_bool
+
+        self.library.rwkv_get_default_sampler_params.argtypes = []
+        self.library.rwkv_get_default_sampler_params.restype = RWKVSamplerParams
+
+        self.library.rwkv_create_sampler.argtypes = [ctypes.c_void_p, ctypes.POINTER(RWKVSamplerParams)]
+        self.library.rwkv_create_sampler.restype = ctypes.c_void_p
+
+        self.library.rwkv_free_sampler.argtypes = [ctypes.c_void_p]
+        self.library.rwkv_free_sampler.restype = None
+
+        self.library.rwkv_sampler_set_logit_bias.argtypes = [
+            ctypes.c_void_p, # sampler
+            P_INT, # tokens
+            P_FLOAT, # biases
+            ctypes.c_size_t # count
+        ]
+        self.library.rwkv_sampler_set_logit_bias.restype = ctypes.c_bool
+
+        self.library.rwkv_sampler_accept.argtypes = [ctypes.c_void_p, ctypes.c_uint32]
+        self.library.rwkv_sampler_accept.restype = ctypes.c_bool
+
+        self.library.rwkv_sampler_reset.argtypes = [ctypes.c_void_p]
+        self.library.rwkv_sampler_reset.restype = None
+
+        self.library.rwkv_sampler_sample.argtypes = [ctypes.c_void_p, P_FLOAT]
+        self.library.rwkv_sampler_sample.restype = ctypes.c_uint32
+
+        self.library.rwkv_create_speculative_decoder.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t]
+        self.library.rwkv_create_speculative_decoder.restype = ctypes.c_void_p
+
+        self.library.rwkv_free_speculative_decoder.argtypes = [ctypes.c_void_p]
+        self.library.rwkv_free_speculative_decoder.restype = None
+
+        self.library.rwkv_speculative_reset.argtypes = [ctypes.c_void_p]
+        self.library.rwkv_speculative_reset.restype = None
+
+        self.library.rwkv_set_speculative_draft_length.argtypes = [ctypes.c_void_p, ctypes.c_size_t]
+        self.library.rwkv_set_speculative_draft_length.restype = None
+
+        self.library.rwkv_speculative_feed.argtypes = [ctypes.c_void_p, P_INT, ctypes.c_size_t]
+        self.library.rwkv_speculative_feed.restype = ctypes.c_bool
+
+        self.library.rwkv_speculative_decode.argtypes = [
+            ctypes.c_void_p, # decoder
+            ctypes.c_void_p, # sampler
+            P_INT, # tokens_out
+            ctypes.c_size_t, # max_count
+            ctypes.POINTER(ctypes.c_size_t) # count_out
+        ]
+        self.library.rwkv_speculative_decode.restype = ctypes.c_bool
+
+        self.library.rwkv_get_speculative_stats.argtypes = [
+            ctypes.c_void_p, # decoder
+            ctypes.POINTER(ctypes.c_uint64), # rounds
+            ctypes.POINTER(ctypes.c_uint64), # drafted_tokens
+            ctypes.POINTER(ctypes.c_uint64), # accepted_tokens
+            ctypes.POINTER(ctypes.c_uint64) # generated_tokens
+        ]
+        self.library.rwkv_get_speculative_stats.restype = None
+
+        self.library.rwkv_get_speculative_acceptance_by_position.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint64), ctypes.c_size_t]
+        self.library.rwkv_get_speculative_acceptance_by_position.restype = ctypes.c_size_t
+
+        self.library.rwkv_reset_speculative_stats.argtypes = [ctypes.c_void_p]
+        self.library.rwkv_reset_speculative_stats.restype = None
+
+        self.library.rwkv_get_default_beam_search_params.argtypes = []
+        self.library.rwkv_get_default_beam_search_params.restype = RWKVBeamSearchParams
+
+        self.library.rwkv_create_beam_search.argtypes = [ctypes.c_void_p, ctypes.POINTER(RWKVBeamSearchParams)]
+        self.library.rwkv_create_beam_search.restype = ctypes.c_void_p
+
+        self.library.rwkv_free_beam_search.argtypes = [ctypes.c_void_p]
+        self.library.rwkv_free_beam_search.restype = None
+
+        self.library.rwkv_beam_search_start.argtypes = [ctypes.c_void_p, P_INT, ctypes.c_size_t, P_FLOAT]
+        self.library.rwkv_beam_search_start.restype = ctypes.c_bool
+
+        self.library.rwkv_beam_search_run.argtypes = [ctypes.c_void_p]
+        self.library.rwkv_beam_search_run.restype = ctypes.c_bool
+
+        self.library.rwkv_beam_search_get_result_count.argtypes = [ctypes.c_void_p]
+        self.library.rwkv_beam_search_get_result_count.restype = ctypes.c_size_t
+
+        self.library.rwkv_beam_search_get_result.argtypes = [
+            ctypes.c_void_p, # search
+            ctypes.c_size_t, # index
+            P_INT, # tokens_out
+            ctypes.c_size_t, # max_tokens
+            ctypes.POINTER(ctypes.c_size_t), # length_out
+            P_FLOAT, # log_prob_out
+            P_FLOAT # score_out
+        ]
+        self.library.rwkv_beam_search_get_result.restype = ctypes.c_bool
+
         self.library.rwkv_get_system_info_string.argtypes = []
         self.library.rwkv_get_system_info_string.restype = ctypes.c_char_p
 
@@ -229,7 +420,7 @@ class RWKVSharedLibrary:
 
         Chunking allows processing sequences of thousands of tokens, while not reaching the ggml's node limit and not consuming too much memory.
         A reasonable and recommended value of chunk size is 16. If you want maximum performance, try different chunk sizes in range [2..64]
-        and choose one that works the best in your use case.
+        and choose one that works the best in your use case, or let rwkv_auto_tune choose one and pass 0.
 
         Not thread-safe. For parallel inference, call `rwkv_clone_context` to create one rwkv_context for each thread.
         Throws an exception in case of any error. Error messages would be printed to stderr.
@@ -241,7 +432,7 @@ class RWKVSharedLibrary:
         tokens : List[int]
             Next token indices, in range 0 <= token < n_vocab.
         chunk_size : int
-            Size of each chunk in tokens, must be positive.
+            Size of each chunk in tokens, 0 means the chunk size chosen by rwkv_auto_tune, or 16 if the context was not tuned.
         state_in_address : int
             Address of the first element of a FP32 buffer of size rwkv_get_state_buffer_element_count; or None, if this is a first pass.
         state_out_address : int
@@ -261,6 +452,107 @@ class RWKVSharedLibrary:
         ):
             raise ValueError('rwkv_eval_sequence_in_chunks failed, check stderr')
 
+    def rwkv_eval_sequence_log_probs(
+            self,
+            ctx: RWKVContext,
+            tokens: List[int],
+            targets: List[int],
+            chunk_size: int,
+            state_in_address: Optional[int],
+            state_out_address: int,
+            log_probs_out_address: int
+    ) -> None:
+        """
+        Evaluates the model for a sequence of tokens and computes log-probabilities of the target tokens.
+        Logits of every token of a chunk are computed by a single head matrix multiplication; only logits of one chunk are kept in memory at a time.
+
+        Not thread-safe. For parallel inference, call `rwkv_clone_context` to create one rwkv_context for each thread.
+        Throws an exception in case of any error. Error messages would be printed to stderr.
+
+        Parameters
+        ----------
+        ctx : RWKVContext
+            RWKV context obtained from rwkv_init_from_file.
+        tokens : List[int]
+            Next token indices, in range 0 <= token < n_vocab.
+        targets : List[int]
+            Target token indices, one per token, in range 0 <= token < n_vocab. Usually tokens shifted by one.
+        chunk_size : int
+            Size of each chunk in tokens, must be positive.
+        state_in_address : int
+            Address of the first element of a FP32 buffer of size rwkv_get_state_buffer_element_count; or None, if this is a first pass.
+        state_out_address : int
+            Address of the first element of a FP32 buffer of size rwkv_get_state_buffer_element_count. This buffer will be written to.
+        log_probs_out_address : int
+            Address of the first element of a FP32 buffer of size len(tokens). This buffer will be written to.
+        """
+
+        if len(targets) != len(tokens):
+            raise ValueError(f'Target count {len(targets)} does not match token count {len(tokens)}')
+
+        if not self.library.rwkv_eval_sequence_log_probs(
+            ctx.ptr,
+            ctypes.cast((ctypes.c_int32 * len(tokens))(*tokens), P_INT),
+            ctypes.cast((ctypes.c_int32 * len(targets))(*targets), P_INT),
+            ctypes.c_size_t(len(tokens)),
+            ctypes.c_size_t(chunk_size),
+            ctypes.cast(0 if state_in_address is None else state_in_address, P_FLOAT),
+            ctypes.cast(state_out_address, P_FLOAT),
+            ctypes.cast(log_probs_out_address, P_FLOAT)
+        ):
+            raise ValueError('rwkv_eval_sequence_log_probs failed, check stderr')
+
+    def rwkv_set_n_threads(self, ctx: RWKVContext, serial_thread_count: int, sequence_thread_count: int) -> None:
+        """
+        Overrides the thread count of the context for following evaluations. Takes effect at the next call and costs nothing,
+        so it can be changed between calls; for example, to give a prefill more threads than the decoding that follows it.
+
+        Parameters
+        ----------
+        ctx : RWKVContext
+            RWKV context obtained from rwkv_init_from_file.
+        serial_thread_count : int
+            Threads of evaluations of single tokens and of batches; 0 means the thread count of the context.
+        sequence_thread_count : int
+            Threads of evaluations of sequences of several tokens; 0 means the thread count of the context.
+        """
+
+        self.library.rwkv_set_n_threads(ctx.ptr, ctypes.c_uint32(serial_thread_count), ctypes.c_uint32(sequence_thread_count))
+
+    def rwkv_auto_tune(self, ctx: RWKVContext, max_thread_count: int) -> Tuple[int, int, int]:
+        """
+        Measures evaluation speed of the loaded model with several chunk sizes and thread counts, and keeps the fastest ones:
+        thread counts are set like with rwkv_set_n_threads, and rwkv_eval_sequence_in_chunks uses the chunk size when given 0.
+        Throws an exception in case of any error. Error messages would be printed to stderr.
+
+        Parameters
+        ----------
+        ctx : RWKVContext
+            RWKV context obtained from rwkv_init_from_file.
+        max_thread_count : int
+            Largest thread count to try; 0 means the count of hardware threads.
+
+        Returns
+        -------
+        chunk_size, serial_thread_count, sequence_thread_count
+            The fastest chunk size and thread counts.
+        """
+
+        chunk_size = ctypes.c_size_t(0)
+        serial_thread_count = ctypes.c_uint32(0)
+        sequence_thread_count = ctypes.c_uint32(0)
+
+        if not self.library.rwkv_auto_tune(
+            ctx.ptr,
+            ctypes.c_uint32(max_thread_count),
+            ctypes.byref(chunk_size),
+            ctypes.byref(serial_thread_count),
+            ctypes.byref(sequence_thread_count)
+        ):
+            raise ValueError('rwkv_auto_tune failed, check stderr')
+
+        return chunk_size.value, serial_thread_count.value, sequence_thread_count.value
+
     def rwkv_get_n_vocab(self, ctx: RWKVContext) -> int:
         """
         Returns the number of tokens in the given model's vocabulary.
@@ -340,7 +632,59 @@ class RWKVSharedLibrary:
 
         ctx.ptr = self.nullptr
 
-    def rwkv_quantize_model_file(self, model_file_path_in: str, model_file_path_out: str, format_name: str) -> None:
+    def rwkv_start_imatrix_collection(self, ctx: RWKVContext) -> None:
+        """
+        Starts collecting an importance matrix for quantization from all following evaluations of the context.
+        Calling this function again discards already collected statistics.
+        Throws an exception in case of any error. Error messages would be printed to stderr.
+
+        Parameters
+        ----------
+        ctx : RWKVContext
+            RWKV context obtained from rwkv_init_from_file.
+        """
+
+        if not self.library.rwkv_start_imatrix_collection(ctx.ptr):
+            raise ValueError('rwkv_start_imatrix_collection failed, check stderr')
+
+    def rwkv_save_imatrix(self, ctx: RWKVContext, file_path: str) -> None:
+        """
+        Writes the importance matrix collected since rwkv_start_imatrix_collection to a file, which can be passed to rwkv_quantize_model_file.
+        Collection continues after writing.
+        Throws an exception in case of any error. Error messages would be printed to stderr.
+
+        Parameters
+        ----------
+        ctx : RWKVContext
+            RWKV context obtained from rwkv_init_from_file.
+        file_path : str
+            Path to the file, will be overwritten.
+        """
+
+        if not self.library.rwkv_save_imatrix(ctx.ptr, file_path.encode('utf-8')):
+            raise ValueError('rwkv_save_imatrix failed, check stderr')
+
+    def rwkv_stop_imatrix_collection(self, ctx: RWKVContext) -> None:
+        """
+        Stops collecting the importance matrix and discards collected statistics.
+
+        Parameters
+        ----------
+        ctx : RWKVContext
+            RWKV context obtained from rwkv_init_from_file.
+        """
+
+        self.library.rwkv_stop_imatrix_collection(ctx.ptr)
+
+    def rwkv_quantize_model_file(
+            self,
+            model_file_path_in: str,
+            model_file_path_out: str,
+            format_name: str,
+            thread_count: int = 1,
+            policy: Optional[str] = None,
+            imatrix_path: Optional[str] = None
+    ) -> None:
         """
         Quantizes FP32 or FP16 model to one of INT4 formats.
         Throws an exception in case of any error. Error messages would be printed to stderr.
@@ -353,18 +697,445 @@ class RWKVSharedLibrary:
             Quantized model will be written here.
         format_name : str
             One of QUANTIZED_FORMAT_NAMES.
+        thread_count : int
+            Count of threads quantizing each matrix, must be positive.
+        policy : Optional[str]
+            Per-tensor data types, like "ffn.key=Q4_K,head=Q8_0,@last:2=Q8_0"; see rwkv_quantize_params in rwkv.h.
+        imatrix_path : Optional[str]
+            Path to an importance matrix file written by rwkv_save_imatrix.
         """
 
         if format_name not in QUANTIZED_FORMAT_NAMES:
             raise ValueError(f'Unknown format name {format_name}, use one of {QUANTIZED_FORMAT_NAMES}')
 
-        if not self.library.rwkv_quantize_model_file(
+        assert thread_count > 0, 'Thread count must be positive'
+
+        params: RWKVQuantizeParams = self.library.rwkv_get_default_quantize_params()
+        params.n_threads = thread_count
+        params.policy = policy.encode('utf-8') if policy is not None else None
+        params.imatrix = imatrix_path.encode('utf-8') if imatrix_path is not None else None
+
+        if not self.library.rwkv_quantize_model_file_with_params(
             model_file_path_in.encode('utf-8'),
             model_file_path_out.encode('utf-8'),
-            format_name.encode('utf-8')
+            format_name.encode('utf-8'),
+            ctypes.byref(params)
         ):
             raise ValueError('rwkv_quantize_model_file failed, check stderr')
 
+    def rwkv_create_sampler(
+            self,
+            ctx: RWKVContext,
+            temperature: float = 1.0,
+            top_k: int = 0,
+            top_p: float = 1.0,
+            min_p: float = 0.0,
+            repetition_penalty: float = 1.0,
+            presence_penalty: float = 0.0,
+            frequency_penalty: float = 0.0,
+            penalty_last_n: int = 64,
+            seed: int = 0
+    ) -> RWKVSampler:
+        """
+        Creates a sampler for the vocabulary of the model of the context.
+        Throws an exception in case of any error. Error messages would be printed to stderr.
+
+        Parameters
+        ----------
+        ctx : RWKVContext
+            RWKV context obtained from rwkv_init_from_file.
+        temperature : float
+            Must not be negative. With 0, the most likely token is always chosen.
+        top_k : int
+            Count of most likely tokens to keep; 0 keeps all tokens.
+        top_p : float
+            Probability mass of most likely tokens to keep, in range (0, 1].
+        min_p : float
+            Tokens less likely than min_p times the probability of the most likely token are dropped.
+        repetition_penalty : float
+            Positive logits of recently accepted tokens are divided by it, negative logits are multiplied by it.
+        presence_penalty : float
+            Subtracted from logits of recently accepted tokens.
+        frequency_penalty : float
+            Subtracted from logits of recently accepted tokens once per occurrence.
+        penalty_last_n : int
+            Count of last accepted tokens that penalties apply to.
+        seed : int
+            Seed of the random number generator.
+        """
+
+        params: RWKVSamplerParams = self.library.rwkv_get_default_sampler_params()
+        params.temperature = temperature
+        params.top_k = top_k
+        params.top_p = top_p
+        params.min_p = min_p
+        params.repetition_penalty = repetition_penalty
+        params.presence_penalty = presence_penalty
+        params.frequency_penalty = frequency_penalty
+        params.penalty_last_n = penalty_last_n
+        params.seed = seed
+
+        ptr = self.library.rwkv_create_sampler(ctx.ptr, ctypes.byref(params))
+
+        if ptr is None:
+            raise ValueError('rwkv_create_sampler failed, check stderr')
+
+        return RWKVSampler(ptr)
+
+    def rwkv_free_sampler(self, sampler: RWKVSampler) -> None:
+        """
+        Frees the sampler.
+
+        Parameters
+        ----------
+        sampler : RWKVSampler
+            Sampler obtained from rwkv_create_sampler.
+        """
+
+        self.library.rwkv_free_sampler(sampler.ptr)
+
+        sampler.ptr = self.nullptr
+
+    def rwkv_sampler_set_logit_bias(self, sampler: RWKVSampler, logit_bias: Dict[int, float]) -> None:
+        """
+        Replaces the logit bias of the sampler. A bias of float('-inf') bans the token.
+        Throws an exception in case of any error. Error messages would be printed to stderr.
+
+        Parameters
+        ----------
+        sampler : RWKVSampler
+            Sampler obtained from rwkv_create_sampler.
+        logit_bias : Dict[int, float]
+            Biases added to logits of tokens; an empty dict removes the bias.
+        """
+
+        count: int = len(logit_bias)
+
+        if not self.library.rwkv_sampler_set_logit_bias(
+            sampler.ptr,
+            ctypes.cast((ctypes.c_int32 * count)(*logit_bias.keys()), P_INT),
+            ctypes.cast((ctypes.c_float * count)(*logit_bias.values()), P_FLOAT),
+            ctypes.c_size_t(count)
+        ):
+            raise ValueError('rwkv_sampler_set_logit_bias failed, check stderr')
+
+    def rwkv_sampler_accept(self, sampler: RWKVSampler, token: int) -> None:
+        """
+        Adds the token to the history of the sampler that penalties apply to; use it for prompt tokens.
+        Sampled tokens are added automatically.
+        Throws an exception in case of any error. Error messages would be printed to stderr.
+
+        Parameters
+        ----------
+        sampler : RWKVSampler
+            Sampler obtained from rwkv_create_sampler.
+        token : int
+            Token index, in range 0 <= token < n_vocab.
+        """
+
+        if not self.library.rwkv_sampler_accept(sampler.ptr, ctypes.c_uint32(token)):
+            raise ValueError('rwkv_sampler_accept failed, check stderr')
+
+    def rwkv_sampler_reset(self, sampler: RWKVSampler) -> None:
+        """
+        Clears the history of the sampler and reseeds its random number generator.
+
+        Parameters
+        ----------
+        sampler : RWKVSampler
+            Sampler obtained from rwkv_create_sampler.
+        """
+
+        self.library.rwkv_sampler_reset(sampler.ptr)
+
+    def rwkv_sampler_sample(self, sampler: RWKVSampler, logits_address: int) -> int:
+        """
+        Samples a token from logits and adds it to the history of the sampler.
+
+        Parameters
+        ----------
+        sampler : RWKVSampler
+            Sampler obtained from rwkv_create_sampler.
+        logits_address : int
+            Address of the first element of a FP32 buffer of size rwkv_get_logits_buffer_element_count.
+        """
+
+        return self.library.rwkv_sampler_sample(sampler.ptr, ctypes.cast(logits_address, P_FLOAT))
+
+    def rwkv_create_speculative_decoder(self, target_ctx: RWKVContext, draft_ctx: RWKVContext, draft_length: int) -> RWKVSpeculativeDecoder:
+        """
+        Creates a speculative decoder, which generates tokens of the target model with a small draft model proposing them.
+        The draft model must have the same vocabulary. The decoder must be freed before the contexts.
+        Throws an exception in case of any error. Error messages would be printed to stderr.
+
+        Parameters
+        ----------
+        target_ctx : RWKVContext
+            RWKV context of the target model.
+        draft_ctx : RWKVContext
+            RWKV context of the draft model.
+        draft_length : int
+            Count of tokens the draft model proposes per round, must be positive.
+        """
+
+        ptr = self.library.rwkv_create_speculative_decoder(target_ctx.ptr, draft_ctx.ptr, ctypes.c_size_t(draft_length))
+
+        if ptr is None:
+            raise ValueError('rwkv_create_speculative_decoder failed, check stderr')
+
+        return RWKVSpeculativeDecoder(ptr)
+
+    def rwkv_free_speculative_decoder(self, decoder: RWKVSpeculativeDecoder) -> None:
+        """
+        Frees the speculative decoder.
+
+        Parameters
+        ----------
+        decoder : RWKVSpeculativeDecoder
+            Decoder obtained from rwkv_create_speculative_decoder.
+        """
+
+        self.library.rwkv_free_speculative_decoder(decoder.ptr)
+
+        decoder.ptr = self.nullptr
+
+    def rwkv_speculative_reset(self, decoder: RWKVSpeculativeDecoder) -> None:
+        """
+        Resets the states of the decoder to initial states. Statistics are kept.
+
+        Parameters
+        ----------
+        decoder : RWKVSpeculativeDecoder
+            Decoder obtained from rwkv_create_speculative_decoder.
+        """
+
+        self.library.rwkv_speculative_reset(decoder.ptr)
+
+    def rwkv_set_speculative_draft_length(self, decoder: RWKVSpeculativeDecoder, draft_length: int) -> None:
+        """
+        Changes the count of tokens the draft model proposes per round.
+
+        Parameters
+        ----------
+        decoder : RWKVSpeculativeDecoder
+            Decoder obtained from rwkv_create_speculative_decoder.
+        draft_length : int
+            Count of tokens, must be positive.
+        """
+
+        self.library.rwkv_set_speculative_draft_length(decoder.ptr, ctypes.c_size_t(draft_length))
+
+    def rwkv_speculative_feed(self, decoder: RWKVSpeculativeDecoder, tokens: List[int]) -> None:
+        """
+        Evaluates tokens, like a prompt or user input, with both models.
+        Throws an exception in case of any error. Error messages would be printed to stderr.
+
+        Parameters
+        ----------
+        decoder : RWKVSpeculativeDecoder
+            Decoder obtained from rwkv_create_speculative_decoder.
+        tokens : List[int]
+            Token indices, in range 0 <= token < n_vocab. Must not be empty.
+        """
+
+        if not self.library.rwkv_speculative_feed(
+            decoder.ptr,
+            ctypes.cast((ctypes.c_int32 * len(tokens))(*tokens), P_INT),
+            ctypes.c_size_t(len(tokens))
+        ):
+            raise ValueError('rwkv_speculative_feed failed, check stderr')
+
+    def rwkv_speculative_decode(self, decoder: RWKVSpeculativeDecoder, sampler: RWKVSampler, max_count: int) -> List[int]:
+        """
+        Runs one round of speculative decoding and returns between 1 and min(draft_length + 1, max_count) emitted tokens.
+        Throws an exception in case of any error. Error messages would be printed to stderr.
+
+        Parameters
+        ----------
+        decoder : RWKVSpeculativeDecoder
+            Decoder obtained from rwkv_create_speculative_decoder.
+        sampler : RWKVSampler
+            Sampler obtained from rwkv_create_sampler.
+        max_count : int
+            Maximum count of emitted tokens, must be positive.
+        """
+
+        tokens = (ctypes.c_int32 * max_count)()
+        count = ctypes.c_size_t(0)
+
+        if not self.library.rwkv_speculative_decode(
+            decoder.ptr,
+            sampler.ptr,
+            ctypes.cast(tokens, P_INT),
+            ctypes.c_size_t(max_count),
+            ctypes.byref(count)
+        ):
+            raise ValueError('rwkv_speculative_decode failed, check stderr')
+
+        return list(tokens[0:count.value])
+
+    def rwkv_get_speculative_stats(self, decoder: RWKVSpeculativeDecoder) -> Dict[str, int]:
+        """
+        Returns statistics of the decoder: rounds, drafted_tokens, accepted_tokens and generated_tokens.
+
+        Parameters
+        ----------
+        decoder : RWKVSpeculativeDecoder
+            Decoder obtained from rwkv_create_speculative_decoder.
+        """
+
+        rounds = ctypes.c_uint64(0)
+        drafted_tokens = ctypes.c_uint64(0)
+        accepted_tokens = ctypes.c_uint64(0)
+        generated_tokens = ctypes.c_uint64(0)
+
+        self.library.rwkv_get_speculative_stats(
+            decoder.ptr,
+            ctypes.byref(rounds),
+            ctypes.byref(drafted_tokens),
+            ctypes.byref(accepted_tokens),
+            ctypes.byref(generated_tokens)
+        )
+
+        return {
+            'rounds': rounds.value,
+            'drafted_tokens': drafted_tokens.value,
+            'accepted_tokens': accepted_tokens.value,
+            'generated_tokens': generated_tokens.value
+        }
+
+    def rwkv_get_speculative_acceptance_by_position(self, decoder: RWKVSpeculativeDecoder) -> List[int]:
+        """
+        Returns counts of rounds in which the drafted token at each position was accepted.
+
+        Parameters
+        ----------
+        decoder : RWKVSpeculativeDecoder
+            Decoder obtained from rwkv_create_speculative_decoder.
+        """
+
+        count: int = self.library.rwkv_get_speculative_acceptance_by_position(decoder.ptr, None, 0)
+        counts = (ctypes.c_uint64 * count)()
+
+        self.library.rwkv_get_speculative_acceptance_by_position(decoder.ptr, counts, ctypes.c_size_t(count))
+
+        return list(counts)
+
+    def rwkv_reset_speculative_stats(self, decoder: RWKVSpeculativeDecoder) -> None:
+        """
+        Resets all statistics of the decoder to 0.
+
+        Parameters
+        ----------
+        decoder : RWKVSpeculativeDecoder
+            Decoder obtained from rwkv_create_speculative_decoder.
+        """
+
+        self.library.rwkv_reset_speculative_stats(decoder.ptr)
+
+    def rwkv_create_beam_search(
+            self,
+            ctx: RWKVContext,
+            beam_width: int = 4,
+            max_tokens: int = 32,
+            length_penalty: float = 1.0,
+            end_token: int = -1
+    ) -> RWKVBeamSearch:
+        """
+        Creates a beam search for the model of the context. The search must be freed before the context.
+        Throws an exception in case of any error. Error messages would be printed to stderr.
+
+        Parameters
+        ----------
+        ctx : RWKVContext
+            RWKV context obtained from rwkv_init_from_file.
+        beam_width : int
+            Count of live beams and of kept results, in range 0 < beam_width <= n_vocab.
+        max_tokens : int
+            Count of generated tokens after which a beam ends, must be positive.
+        length_penalty : float
+            Exponent of the length that log-probabilities of results are divided by; 0 ranks by log-probability alone.
+        end_token : int
+            Token that ends a beam, or -1.
+        """
+
+        params = self.library.rwkv_get_default_beam_search_params()
+        params.beam_width = beam_width
+        params.max_tokens = max_tokens
+        params.length_penalty = length_penalty
+        params.end_token = end_token
+
+        ptr = self.library.rwkv_create_beam_search(ctx.ptr, ctypes.byref(params))
+
+        if ptr is None:
+            raise ValueError('rwkv_create_beam_search failed, check stderr')
+
+        return RWKVBeamSearch(ptr)
+
+    def rwkv_free_beam_search(self, search: RWKVBeamSearch) -> None:
+        """
+        Frees the beam search.
+
+        Parameters
+        ----------
+        search : RWKVBeamSearch
+            Beam search obtained from rwkv_create_beam_search.
+        """
+
+        self.library.rwkv_free_beam_search(search.ptr)
+
+        search.ptr = self.nullptr
+
+    def rwkv_beam_search(
+            self,
+            search: RWKVBeamSearch,
+            prompt: List[int],
+            state_in_address: Optional[int]
+    ) -> List[Tuple[List[int], float, float]]:
+        """
+        Runs the beam search from the prompt and returns results sorted by score, the best one first.
+        Each result is a tuple of generated tokens, their log-probability and the score.
+        Throws an exception in case of any error. Error messages would be printed to stderr.
+
+        Parameters
+        ----------
+        search : RWKVBeamSearch
+            Beam search obtained from rwkv_create_beam_search.
+        prompt : List[int]
+            Prompt token indices, in range 0 <= token < n_vocab. Must not be empty.
+        state_in_address : int
+            Address of the first element of a FP32 buffer of size rwkv_get_state_buffer_element_count with the state before the prompt;
+            or None, to start from the initial state.
+        """
+
+        if not self.library.rwkv_beam_search_start(
+            search.ptr,
+            ctypes.cast((ctypes.c_int32 * len(prompt))(*prompt), P_INT),
+            ctypes.c_size_t(len(prompt)),
+            ctypes.cast(0 if state_in_address is None else state_in_address, P_FLOAT)
+        ):
+            raise ValueError('rwkv_beam_search_start failed, check stderr')
+
+        if not self.library.rwkv_beam_search_run(search.ptr):
+            raise ValueError('rwkv_beam_search_run failed, check stderr')
+
+        results: List[Tuple[List[int], float, float]] = []
+
+        for i in range(self.library.rwkv_beam_search_get_result_count(search.ptr)):
+            length = ctypes.c_size_t(0)
+            log_prob = ctypes.c_float(0.0)
+            score = ctypes.c_float(0.0)
+
+            self.library.rwkv_beam_search_get_result(search.ptr, ctypes.c_size_t(i), None, ctypes.c_size_t(0), ctypes.byref(length), ctypes.byref(log_prob), ctypes.byref(score))
+
+            tokens = (ctypes.c_int32 * length.value)()
+
+            self.library.rwkv_beam_search_get_result(search.ptr, ctypes.c_size_t(i), ctypes.cast(tokens, P_INT), length, None, None, None)
+
+            results.append((list(tokens), log_prob.value, score.value))
+
+        return results
+
     def rwkv_get_system_info_string(self) -> str:
         """
         Returns system information string.
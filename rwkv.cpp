@@ -25,8 +25,17 @@
 #include <cmath>
 #include <fstream>
 #include <unordered_map>
+#include <map>
 #include <memory>
 #include <utility>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <initializer_list>
+#include <random>
 
 #define _FILE_OFFSET_BITS 64
 // Puts an optional break point, if debug is enabled.
@@ -35,6 +44,10 @@
 #include <sys/stat.h>
 
 #if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+#    define WIN32_LEAN_AND_MEAN
+#    define NOMINMAX
+#    include <windows.h>
+#    include <io.h>
 #    define stat _stat64
 #    define fstat _fstat64
 #    define ftell _ftelli64
@@ -44,6 +57,11 @@
 #        define RWKV_MAYBE_BREAK __debugbreak()
 #    endif
 #else
+#    include <sys/mman.h>
+#    include <unistd.h>
+#    if defined(__linux__)
+#        include <sys/syscall.h>
+#    endif
 #    if !defined(__APPLE__)
 #        define ftell ftello
 #        define fseek fseeko
@@ -67,17 +85,106 @@ static_assert(sizeof(decltype(ftell(NULL))) >= 8, "File offsets should be 64-bit
 
 #include "rwkv_graph.inc"
 
+#include "rwkv_thread_pool.inc"
+
+// API function.
+struct rwkv_init_params rwkv_get_default_init_params(void) {
+    struct rwkv_init_params params;
+    params.n_threads = 1;
+    params.n_gpu_layers = 0;
+    params.use_mmap = false;
+    params.n_load_threads = 1;
+    params.sparse_ffn = false;
+    params.numa_mode = RWKV_NUMA_NONE;
+
+    return params;
+}
+
+// Creates the CPU backend of the context, whose computations run on the CPUs of the NUMA node if it is not negative.
+// The model must be loaded.
+static bool rwkv_init_context_backends(struct rwkv_context * ctx, const int32_t numa_node) {
+    ctx->cpu_backend = ggml_backend_cpu_init();
+    RWKV_ASSERT_FALSE_MSG(RWKV_ERROR_CTX | RWKV_ERROR_ALLOC, ctx->cpu_backend, "Failed to create CPU backend");
+    ggml_backend_cpu_set_n_threads(ctx->cpu_backend, ctx->n_threads);
+
+    // The last backend of the model is its CPU backend, which is only used to load the model.
+    const std::vector<ggml_backend_t> & model_backends = ctx->model->backends;
+    ctx->backends.assign(model_backends.begin(), model_backends.end() - 1);
+    ctx->backends.push_back(ctx->cpu_backend);
+
+    ctx->weights = ctx->model;
+    ctx->numa_node = numa_node;
+
+    if (numa_node < 0) {
+        return true;
+    }
+
+    if (numa_node > 0 && !ctx->model->numa_replicas.empty()) {
+        ctx->weights = ctx->model->numa_replicas[numa_node - 1].get();
+    }
+
+    // Without a CPU list, threads run wherever the system schedules them.
+    const std::vector<uint32_t> cpus = rwkv_numa_node_cpus(numa_node);
+
+    if (!cpus.empty()) {
+        // Only as many threads as the context computes with; they may run on any CPU of the node.
+        ctx->numa_n_threads = (uint32_t) std::min(std::min((size_t) std::max(ctx->n_threads, (uint32_t) 1), cpus.size()), (size_t) GGML_MAX_N_THREADS);
+
+        struct ggml_threadpool_params params = ggml_threadpool_params_default((int) ctx->numa_n_threads);
+        memset(params.cpumask, 0, sizeof(params.cpumask));
+
+        for (const uint32_t cpu : cpus) {
+            if (cpu < GGML_MAX_N_THREADS) {
+                params.cpumask[cpu] = true;
+            }
+        }
+
+        ctx->numa_threadpool = ggml_threadpool_new(&params);
+        RWKV_ASSERT_FALSE_MSG(RWKV_ERROR_CTX | RWKV_ERROR_ALLOC, ctx->numa_threadpool, "Failed to create threads on NUMA node %" PRId32, numa_node);
+        ggml_backend_cpu_set_threadpool(ctx->cpu_backend, ctx->numa_threadpool);
+    }
+
+    return true;
+}
+
 // API function.
 struct rwkv_context * rwkv_init_from_file(const char * file_path, const uint32_t n_threads, const uint32_t n_gpu_layers) {
+    struct rwkv_init_params params = rwkv_get_default_init_params();
+    params.n_threads = n_threads;
+    params.n_gpu_layers = n_gpu_layers;
+
+    return rwkv_init_from_file_with_params(file_path, &params);
+}
+
+// API function.
+struct rwkv_context * rwkv_init_from_file_with_params(const char * file_path, const struct rwkv_init_params * params) {
     global_last_error = RWKV_ERROR_NONE;
 
+    const uint32_t n_threads = params->n_threads;
+    const uint32_t n_gpu_layers = params->n_gpu_layers;
+
+    RWKV_ASSERT_NULL_MSG(
+        RWKV_ERROR_ARGS,
+        params->numa_mode >= RWKV_NUMA_NONE && params->numa_mode <= RWKV_NUMA_REPLICATE,
+        "Invalid NUMA mode %d",
+        (int) params->numa_mode
+    );
+
     std::unique_ptr<struct rwkv_context> ctx(new(std::nothrow) struct rwkv_context());
     RWKV_ASSERT_NULL_MSG(RWKV_ERROR_CTX | RWKV_ERROR_ALLOC, ctx, "Failed to allocate rwkv_context");
 
     ctx->model = new(std::nothrow) struct rwkv_model();
     ctx->model->reference_count++;
+    ctx->model->numa_mode = params->numa_mode;
+
+    if (params->numa_mode == RWKV_NUMA_INTERLEAVE) {
+        // Spreads threads over the nodes, like the weights.
+        static std::once_flag numa_init_flag;
+        std::call_once(numa_init_flag, []() { ggml_numa_init(GGML_NUMA_STRATEGY_DISTRIBUTE); });
+    }
 
     ctx->n_threads = n_threads;
+    ctx->sequential_graph_cache_size = RWKV_DEFAULT_SEQUENTIAL_GRAPH_CACHE_SIZE;
 
     if (n_gpu_layers) {
         ggml_backend_t backend = nullptr;
@@ -112,15 +219,24 @@ struct rwkv_context * rwkv_init_from_file(const char * file_path, const uint32_t
         ngl = 0;
     }
 
-    RWKV_ENSURE_OR_NULL(rwkv_load_model_from_file(file_path, *ctx->model, ngl));
+    RWKV_ENSURE_OR_NULL(rwkv_load_model_from_file(file_path, *ctx->model, ngl, params->use_mmap, params->n_load_threads));
+
+    if (params->sparse_ffn) {
+        RWKV_ENSURE_OR_NULL(rwkv_prepare_sparse_ffn(*ctx->model, std::max(params->n_load_threads, n_threads)));
+    }
+
+    if (params->numa_mode == RWKV_NUMA_REPLICATE) {
+        RWKV_ENSURE_OR_NULL(rwkv_create_numa_replicas(*ctx->model, std::max(params->n_load_threads, n_threads)));
+    }
 
-    RWKV_ENSURE_OR_NULL(rwkv_measure_and_build_serial_context(*ctx->model, ctx->serial_graph));
+    RWKV_ENSURE_OR_NULL(rwkv_init_context_backends(ctx.get(), -1));
+    RWKV_ENSURE_OR_NULL(rwkv_measure_and_build_serial_context(*ctx->weights, ctx->serial_graph));
 
     return ctx.release();
 }
 
-// API function.
-struct rwkv_context * rwkv_clone_context(struct rwkv_context * ctx, const uint32_t n_threads) {
+// Creates a context that shares the model of ctx, whose computations run on the NUMA node if it is not negative.
+static struct rwkv_context * rwkv_clone_context_on(struct rwkv_context * ctx, const uint32_t n_threads, const int32_t numa_node) {
     std::unique_ptr<struct rwkv_context> clone(new(std::nothrow) struct rwkv_context());
     RWKV_ASSERT_NULL_MSG(RWKV_ERROR_CTX | RWKV_ERROR_ALLOC, clone, "Failed to allocate rwkv_context");
 
@@ -129,17 +245,57 @@ struct rwkv_context * rwkv_clone_context(struct rwkv_context * ctx, const uint32
 
     clone->n_threads = n_threads;
 
-    RWKV_ENSURE_OR_NULL(rwkv_measure_and_build_serial_context(*clone->model, clone->serial_graph));
+    RWKV_ENSURE_OR_NULL(rwkv_init_context_backends(clone.get(), numa_node));
+    RWKV_ENSURE_OR_NULL(rwkv_attach_thread_pool(clone.get(), ctx->thread_pool));
+    RWKV_ENSURE_OR_NULL(rwkv_measure_and_build_serial_context(*clone->weights, clone->serial_graph));
 
-    clone->last_used_sequence_length = 0;
+    clone->sequential_graph_cache_size = ctx->sequential_graph_cache_size;
+    clone->sequence_length_bucketing = ctx->sequence_length_bucketing;
+    clone->tuned_chunk_size = ctx->tuned_chunk_size;
 
     clone->print_errors = ctx->print_errors;
 
     return clone.release();
 }
 
+// API function.
+struct rwkv_context * rwkv_clone_context(struct rwkv_context * ctx, const uint32_t n_threads) {
+    return rwkv_clone_context_on(ctx, n_threads, ctx->numa_node);
+}
+
+// API function.
+uint32_t rwkv_get_numa_node_count(void) {
+    return rwkv_numa_node_count();
+}
+
+// API function.
+struct rwkv_context * rwkv_clone_context_on_numa_node(struct rwkv_context * ctx, const uint32_t n_threads, const uint32_t node) {
+    global_last_error = RWKV_ERROR_NONE;
+
+    const uint32_t node_count = rwkv_numa_node_count();
+    RWKV_ASSERT_NULL_MSG(RWKV_ERROR_ARGS, node < node_count, "NUMA node %" PRIu32 " is out of range (0 .. %" PRIu32 ")", node, node_count - 1);
+
+    return rwkv_clone_context_on(ctx, n_threads, (int32_t) node);
+}
+
+#include "rwkv_state.inc"
+
+#include "rwkv_state_compression.inc"
+
+#include "rwkv_imatrix.inc"
+
 #include "rwkv_eval.inc"
 
+#include "rwkv_auto_tune.inc"
+
+#include "rwkv_prefix_cache.inc"
+
+#include "rwkv_sampler.inc"
+
+#include "rwkv_speculative.inc"
+
+#include "rwkv_beam_search.inc"
+
 // API function.
 // Provided for backwards compatibility.
 extern "C" RWKV_API uint32_t rwkv_get_state_buffer_element_count(const struct rwkv_context * ctx) {
@@ -190,6 +346,14 @@ void rwkv_free(struct rwkv_context * ctx) {
     }
 
     if (--ctx->model->reference_count == 0) {
+        for (auto & replica : ctx->model->numa_replicas) {
+            for (auto buffer : replica->buffers_w) {
+                ggml_backend_buffer_free(buffer);
+            }
+
+            ggml_free(replica->ggml_ctx);
+        }
+
         for (auto buffer : ctx->model->buffers_w) {
             ggml_backend_buffer_free(buffer);
         }
@@ -206,11 +370,21 @@ void rwkv_free(struct rwkv_context * ctx) {
     ggml_backend_sched_free(ctx->serial_graph.sched);
     ggml_free(ctx->serial_graph.ggml_ctx);
 
-    if (ctx->last_used_sequence_length > 0) {
-        ggml_backend_sched_free(ctx->sequential_graph.sched);
-        ggml_free(ctx->sequential_graph.ggml_ctx);
+    for (auto & entry : ctx->sequential_graphs) {
+        rwkv_free_graph(*entry.graph);
+    }
+
+    for (auto & entry : ctx->batch_graphs) {
+        rwkv_free_graph(*entry.graph);
     }
 
+    rwkv_attach_thread_pool(ctx, NULL);
+
+    ggml_backend_free(ctx->cpu_backend);
+    ggml_threadpool_free(ctx->numa_threadpool);
+
+    delete ctx->imatrix;
+
     delete ctx;
 }
 
@@ -24,8 +24,10 @@
 
 #define RWKV_FILE_VERSION_0 100
 #define RWKV_FILE_VERSION_1 101
+// Adds architecture metadata and a tensor index, and aligns tensor data.
+#define RWKV_FILE_VERSION_2 102
 #define RWKV_FILE_VERSION_MIN RWKV_FILE_VERSION_0
-#define RWKV_FILE_VERSION_MAX RWKV_FILE_VERSION_1
+#define RWKV_FILE_VERSION_MAX RWKV_FILE_VERSION_2
 // Default file version is the latest version.
 #define RWKV_FILE_VERSION RWKV_FILE_VERSION_MAX
 
@@ -90,6 +92,51 @@ extern "C" {
     // - n_gpu_layer: count of layers need to load to gpu
     RWKV_API struct rwkv_context * rwkv_init_from_file(const char * model_file_path, const uint32_t n_threads, const uint32_t n_gpu_layers);
 
+    // How weights kept on the CPU are placed on the nodes of a NUMA machine, like a server with several sockets.
+    // Placement applies to weights loaded into memory; weights used in place from a file mapping (use_mmap) stay where the page cache put them.
+    enum rwkv_numa_mode {
+        // Weights are placed on the node of the thread that loads them, so threads of other nodes read them over the interconnect.
+        RWKV_NUMA_NONE = 0,
+        // Pages of weights are spread over all nodes in turn, so that every node serves an equal share of each matrix.
+        RWKV_NUMA_INTERLEAVE = 1,
+        // Weights are placed on node 0 and copied to every other node, using one more copy of the weights per extra node.
+        // Contexts created with rwkv_clone_context_on_numa_node use the copy of their node.
+        RWKV_NUMA_REPLICATE = 2
+    };
+
+    // Parameters of model loading, see rwkv_init_from_file_with_params.
+    // Always start from rwkv_get_default_init_params, so that fields added in the future get their default values.
+    struct rwkv_init_params {
+        // Count of threads to use, must be positive. Default is 1.
+        uint32_t n_threads;
+        // Count of layers to offload to the GPU. Default is 0.
+        uint32_t n_gpu_layers;
+        // Whether to map the model file into memory instead of reading it. Default is false.
+        // Weights kept on the CPU are then used right from the mapping when their data is aligned in the file:
+        // loading takes almost no time and processes using the same model file share its memory through the page cache.
+        // Other weights are copied from the mapping. The file must not be modified while the model is loaded.
+        bool use_mmap;
+        // Count of threads reading the model file when use_mmap is false. Default is 1.
+        // With more than one thread, tensors are read in parallel at known file offsets, which helps on fast storage.
+        uint32_t n_load_threads;
+        // Whether serial evaluation skips columns of the FFN value matrix that are multiplied by zero activations. Default is false.
+        // ReLU squared leaves most FFN activations at zero, so this saves most of the reads of the largest matrix of each layer.
+        // It needs a transposed copy of ffn.value of layers kept on the CPU, in FP16 for FP16 and quantized models and in FP32 for FP32 models,
+        // which increases memory usage by the size of that copy; quantized models grow the most.
+        bool sparse_ffn;
+        // How weights kept on the CPU are placed on NUMA nodes. Default is RWKV_NUMA_NONE.
+        enum rwkv_numa_mode numa_mode;
+    };
+
+    // Returns default model loading parameters.
+    RWKV_API struct rwkv_init_params rwkv_get_default_init_params(void);
+
+    // Loads the model from a file and prepares it for inference, like rwkv_init_from_file, but with more parameters.
+    // Returns NULL on any error.
+    // - model_file_path: path to model file in ggml format.
+    // - params: loading parameters; start from rwkv_get_default_init_params.
+    RWKV_API struct rwkv_context * rwkv_init_from_file_with_params(const char * model_file_path, const struct rwkv_init_params * params);
+
     // Creates a new context from an existing one.
     // This can allow you to run multiple rwkv_eval's in parallel, without having to load a single model multiple times.
     // Each rwkv_context can have one eval running at a time.
@@ -98,6 +145,89 @@ extern "C" {
     // - n_threads: count of threads to use, must be positive.
     RWKV_API struct rwkv_context * rwkv_clone_context(struct rwkv_context * ctx, const uint32_t n_threads);
 
+    // Returns the count of online NUMA nodes of the machine; 1 if it is not a NUMA machine, or on platforms other than Linux.
+    // Nodes are numbered 0 .. count - 1 in order, even if the system numbers them with gaps.
+    RWKV_API uint32_t rwkv_get_numa_node_count(void);
+
+    // Creates a new context from an existing one, like rwkv_clone_context, whose computations run on the CPUs of a NUMA node.
+    // If the model was loaded with RWKV_NUMA_REPLICATE, the context uses the copy of the weights on that node, so that its threads
+    // only read local memory; run one such context per node to use the memory bandwidth of all nodes.
+    // The context starts min(n_threads, CPUs of the node) threads once; thread counts set with rwkv_set_n_threads are capped to that.
+    // Clones of the new context run on the same node.
+    // Returns NULL on any error.
+    // - ctx: context to be cloned.
+    // - n_threads: count of threads to use, must be positive.
+    // - node: NUMA node, less than rwkv_get_numa_node_count.
+    RWKV_API struct rwkv_context * rwkv_clone_context_on_numa_node(struct rwkv_context * ctx, const uint32_t n_threads, const uint32_t node);
+
+    // Overrides the thread count of the context for following evaluations. Takes effect at the next call and costs nothing,
+    // so it can be changed between calls; for example, to give a prefill more threads than the decoding that follows it.
+    // - serial_n_threads: threads of evaluations of single tokens and of batches, which are bound by memory bandwidth;
+    //   0 means the n_threads of the context.
+    // - sequence_n_threads: threads of evaluations of sequences of several tokens, which are bound by computation;
+    //   0 means the n_threads of the context.
+    RWKV_API void rwkv_set_n_threads(struct rwkv_context * ctx, const uint32_t serial_n_threads, const uint32_t sequence_n_threads);
+
+    // Measures evaluation speed of the loaded model with several chunk sizes and thread counts, and keeps the fastest ones:
+    // thread counts are set like with rwkv_set_n_threads, and rwkv_eval_sequence_in_chunks uses the chunk size when given 0.
+    // Each configuration is run once to warm up, then timed 3 times, keeping its fastest run. Takes roughly as long as evaluating
+    // 2500 tokens per candidate thread count; call it once after loading, while the machine is otherwise idle.
+    // Clones of the context inherit the chunk size, but not the thread counts.
+    // Returns false on any error. Any output pointer may be NULL.
+    // - max_threads: largest thread count to try; 0 means the count of hardware threads.
+    // - chunk_size_out: receives the fastest chunk size.
+    // - serial_n_threads_out: receives the fastest thread count of single token evaluation.
+    // - sequence_n_threads_out: receives the fastest thread count of sequence evaluation.
+    RWKV_API bool rwkv_auto_tune(
+        struct rwkv_context * ctx,
+        const uint32_t max_threads,
+        size_t * chunk_size_out,
+        uint32_t * serial_n_threads_out,
+        uint32_t * sequence_n_threads_out
+    );
+
+    // Threads shared by contexts that compute in parallel, for example clones serving concurrent requests.
+    // Without a pool, each context uses its own n_threads threads, so N busy contexts oversubscribe the cores N times.
+    // With a pool, each graph computation of an attached context leases min(thread count, available) threads and returns them
+    // when it ends; a computation waits only if no thread is available. Threads are rebalanced at every computation,
+    // so a long sequence split into chunks gets more threads as other contexts go idle.
+    // The pool is thread-safe. It must outlive the contexts attached to it.
+    struct rwkv_thread_pool;
+
+    // Parameters of a thread pool, see rwkv_create_thread_pool.
+    // Always start from rwkv_get_default_thread_pool_params, so that fields added in the future get their default values.
+    struct rwkv_thread_pool_params {
+        // Count of threads shared by all attached contexts, must be positive. Default is the count of hardware threads.
+        uint32_t n_threads;
+        // Whether threads of the pool, and threads computing with them, run only on cores first_core .. first_core + n_threads - 1.
+        // Useful for keeping inference off cores used by other work.
+        // Default is false.
+        bool pin_threads;
+        // First core of pinned threads. Default is 0.
+        uint32_t first_core;
+    };
+
+    // Returns default thread pool parameters.
+    RWKV_API struct rwkv_thread_pool_params rwkv_get_default_thread_pool_params(void);
+
+    // Creates a thread pool.
+    // Returns NULL on any error. Error messages would be printed to stderr if rwkv_set_print_errors(NULL, true) was called.
+    RWKV_API struct rwkv_thread_pool * rwkv_create_thread_pool(const struct rwkv_thread_pool_params * params);
+
+    // Frees the thread pool. Contexts attached to it must be detached or freed first. Does nothing if pool is NULL.
+    RWKV_API void rwkv_free_thread_pool(struct rwkv_thread_pool * pool);
+
+    // Attaches the context to a pool, or detaches it if pool is NULL. The thread count of the context, see rwkv_set_n_threads,
+    // becomes the most threads that one computation of it may lease. Contexts cloned from an attached context are attached to the same pool.
+    // Starts a group of the pool's threads for the context once; computations only wake the threads they lease.
+    // Must not be called while the context is computing. Returns false on any error.
+    RWKV_API bool rwkv_set_thread_pool(struct rwkv_context * ctx, struct rwkv_thread_pool * pool);
+
+    // Gets statistics of the pool. Any output pointer may be NULL.
+    // - computations_out: receives the count of graph computations that leased threads from the pool.
+    // - waits_out: receives the count of computations that had to wait, because all threads were leased.
+    RWKV_API void rwkv_get_thread_pool_stats(struct rwkv_thread_pool * pool, uint64_t * computations_out, uint64_t * waits_out);
+
     // Evaluates the model for a single token.
     // You can pass NULL to logits_out whenever logits are not needed. This can improve speed by ~10 ms per iteration, because logits are not calculated.
     // Not thread-safe. For parallel inference, call rwkv_clone_context to create one rwkv_context for each thread.
@@ -152,13 +282,13 @@ extern "C" {
     //
     // Chunking allows processing sequences of thousands of tokens, while not reaching the ggml's node limit and not consuming too much memory.
     // A reasonable and recommended value of chunk size is 16. If you want maximum performance, try different chunk sizes in range [2..64]
-    // and choose one that works the best in your use case.
+    // and choose one that works the best in your use case, or let rwkv_auto_tune choose one and pass 0.
     //
     // Not thread-safe. For parallel inference, call `rwkv_clone_context` to create one rwkv_context for each thread.
     // Returns false on any error.
     // - tokens: pointer to an array of tokens. If NULL, the graph will be built and cached, but not executed: this can be useful for initialization.
     // - sequence_len: number of tokens to read from the array.
-    // - chunk_size: size of each chunk in tokens, must be positive.
+    // - chunk_size: size of each chunk in tokens; 0 means the chunk size chosen by rwkv_auto_tune, or 16 if the context was not tuned.
     // - state_in: FP32 buffer of size rwkv_get_state_len(), or NULL if this is a first pass.
     // - state_out: FP32 buffer of size rwkv_get_state_len(). This buffer will be written to if non-NULL.
     // - logits_out: FP32 buffer of size rwkv_get_logits_len(). This buffer will be written to if non-NULL.
@@ -172,6 +302,478 @@ extern "C" {
         float * logits_out
     );
 
+    // Evaluates the model for a single token like rwkv_eval, but computes logits of the candidate tokens only.
+    // Only the candidate rows of the head are multiplied, which is much faster than rwkv_eval for large vocabularies
+    // when scores of a few tokens are needed, like for classification or constrained decoding.
+    // If the head is offloaded to the GPU, all logits are computed and the candidate logits are picked from them.
+    // Not thread-safe. For parallel inference, call rwkv_clone_context to create one rwkv_context for each thread.
+    // Returns false on any error.
+    // - token: next token index, in range 0 <= token < n_vocab.
+    // - state_in: FP32 buffer of size rwkv_get_state_len(), or NULL if this is a first pass.
+    // - state_out: FP32 buffer of size rwkv_get_state_len(). This buffer will be written to if non-NULL.
+    // - candidates: token indices, in range 0 <= token < n_vocab. May repeat.
+    // - candidate_count: number of tokens to read from the array.
+    // - logits_out: FP32 buffer of size candidate_count; logits_out[i] receives the logit of candidates[i].
+    RWKV_API bool rwkv_eval_with_candidates(
+        struct rwkv_context * ctx,
+        const uint32_t token,
+        const float * state_in,
+        float * state_out,
+        const uint32_t * candidates,
+        const size_t candidate_count,
+        float * logits_out
+    );
+
+    // Evaluates the model for a sequence of tokens like rwkv_eval_sequence, but computes logits of the candidate tokens only,
+    // see rwkv_eval_with_candidates. The last token is evaluated serially.
+    // Not thread-safe. For parallel inference, call rwkv_clone_context to create one rwkv_context for each thread.
+    // Returns false on any error.
+    RWKV_API bool rwkv_eval_sequence_with_candidates(
+        struct rwkv_context * ctx,
+        const uint32_t * sequence,
+        const size_t sequence_len,
+        const float * state_in,
+        float * state_out,
+        const uint32_t * candidates,
+        const size_t candidate_count,
+        float * logits_out
+    );
+
+    // Evaluates the model for a sequence of tokens like rwkv_eval_sequence, but computes logits after every token of the sequence,
+    // with a single head matrix multiplication. Useful for scoring continuations and measuring perplexity.
+    // The sequence is not split by sequence length bucketing; graphs are cached separately from rwkv_eval_sequence graphs.
+    // Not thread-safe. For parallel inference, call rwkv_clone_context to create one rwkv_context for each thread.
+    // Returns false on any error.
+    // - sequence: pointer to an array of tokens, each in range 0 <= token < n_vocab.
+    // - sequence_len: number of tokens to read from the array, must be positive.
+    // - state_in: FP32 buffer of size rwkv_get_state_len(), or NULL if this is a first pass.
+    // - state_out: FP32 buffer of size rwkv_get_state_len(). This buffer will be written to if non-NULL.
+    // - logits_out: FP32 buffer of size sequence_len * rwkv_get_logits_len(); row i receives logits after sequence[i].
+    //   This buffer will be written to if non-NULL.
+    RWKV_API bool rwkv_eval_sequence_all_logits(
+        struct rwkv_context * ctx,
+        const uint32_t * sequence,
+        const size_t sequence_len,
+        const float * state_in,
+        float * state_out,
+        float * logits_out
+    );
+
+    // Evaluates the model for a sequence of tokens and computes log-probabilities of the target tokens,
+    // using rwkv_eval_sequence_all_logits on chunks of the sequence. Only logits of one chunk are kept in memory at a time,
+    // so that long documents can be scored.
+    // Not thread-safe. For parallel inference, call rwkv_clone_context to create one rwkv_context for each thread.
+    // Returns false on any error.
+    // - sequence: pointer to an array of tokens, each in range 0 <= token < n_vocab.
+    // - targets: pointer to an array of sequence_len tokens, each in range 0 <= token < n_vocab.
+    //   Usually the sequence shifted by one token.
+    // - sequence_len: number of tokens to read from the arrays, must be positive.
+    // - chunk_size: size of each chunk in tokens, must be positive.
+    // - state_in: FP32 buffer of size rwkv_get_state_len(), or NULL if this is a first pass.
+    // - state_out: FP32 buffer of size rwkv_get_state_len(). This buffer will be written to if non-NULL.
+    // - log_probs_out: FP32 buffer of size sequence_len; log_probs_out[i] receives the natural logarithm of the probability
+    //   of targets[i] after sequence[i].
+    RWKV_API bool rwkv_eval_sequence_log_probs(
+        struct rwkv_context * ctx,
+        const uint32_t * sequence,
+        const uint32_t * targets,
+        const size_t sequence_len,
+        const size_t chunk_size,
+        const float * state_in,
+        float * state_out,
+        float * log_probs_out
+    );
+
+    // Evaluates the model for a batch of independent sequences, advancing each of them by a single token.
+    // All sequences are processed by a single graph, so that each weight matrix is read from memory once per call instead of once per sequence.
+    // This is much faster than calling `rwkv_eval` for each sequence when serving multiple sessions at once.
+    // Has to build a computation graph on the first call for a given batch size, but will use this cached graph for subsequent calls of the same batch size.
+    // Graphs of the 4 most recently used batch sizes stay cached.
+    // Not thread-safe. For parallel inference, call `rwkv_clone_context` to create one rwkv_context for each thread.
+    // Returns false on any error.
+    // - tokens: array of batch_size tokens, one per sequence, each in range 0 <= token < n_vocab.
+    // - batch_size: number of sequences, must be positive.
+    // - states_in: array of batch_size FP32 buffers of size rwkv_get_state_len(). The array or any of its elements can be NULL for a first pass.
+    // - states_out: array of batch_size FP32 buffers of size rwkv_get_state_len(), or NULL. Non-NULL buffers will be written to.
+    //   A buffer may be the same as the corresponding input buffer.
+    // - logits_out: array of batch_size FP32 buffers of size rwkv_get_logits_len(), or NULL. Non-NULL buffers will be written to.
+    //   If the array itself is NULL or all of its buffers are NULL, logits are not calculated.
+    RWKV_API bool rwkv_eval_batch(
+        struct rwkv_context * ctx,
+        const uint32_t * tokens,
+        const size_t batch_size,
+        const float * const * states_in,
+        float * const * states_out,
+        float * const * logits_out
+    );
+
+    // Opaque model state that is kept in a backend buffer between eval calls.
+    // Evaluating with rwkv_eval_in_state and rwkv_eval_sequence_in_state reads and writes the state in place,
+    // avoiding the two full state copies per call that rwkv_eval does with host float buffers.
+    // A state can be used with any context that shares the model it was created with, but only by one context at a time.
+    struct rwkv_state;
+
+    // Creates a state handle, initialized to the initial state of the model, like rwkv_init_state.
+    // Returns NULL on any error. The state must be freed with rwkv_free_state.
+    RWKV_API struct rwkv_state * rwkv_create_state(struct rwkv_context * ctx);
+
+    // Sets the state back to the initial state of the model.
+    // Returns false on any error.
+    RWKV_API bool rwkv_reset_state(struct rwkv_context * ctx, struct rwkv_state * state);
+
+    // Copies host floats into the state.
+    // Returns false on any error.
+    // - state_in: FP32 buffer of size rwkv_get_state_len().
+    RWKV_API bool rwkv_import_state(struct rwkv_context * ctx, struct rwkv_state * state, const float * state_in);
+
+    // Copies the state into host floats.
+    // Returns false on any error.
+    // - state_out: FP32 buffer of size rwkv_get_state_len().
+    RWKV_API bool rwkv_export_state(struct rwkv_context * ctx, const struct rwkv_state * state, float * state_out);
+
+    // Frees the state. Does nothing if state is NULL.
+    RWKV_API void rwkv_free_state(struct rwkv_state * state);
+
+    // Evaluates the model for a single token, reading and updating the state in place.
+    // Same as rwkv_eval otherwise.
+    // Not thread-safe. For parallel inference, call rwkv_clone_context to create one rwkv_context for each thread.
+    // Returns false on any error.
+    // - token: next token index, in range 0 <= token < n_vocab.
+    // - state: state handle created by rwkv_create_state.
+    // - logits_out: FP32 buffer of size rwkv_get_logits_len(). This buffer will be written to if non-NULL.
+    RWKV_API bool rwkv_eval_in_state(struct rwkv_context * ctx, const uint32_t token, struct rwkv_state * state, float * logits_out);
+
+    // Evaluates the model for a sequence of tokens, reading and updating the state in place.
+    // Same as rwkv_eval_sequence otherwise.
+    // Not thread-safe. For parallel inference, call rwkv_clone_context to create one rwkv_context for each thread.
+    // Returns false on any error.
+    // - sequence: pointer to an array of tokens. If NULL, the graph will be built and cached, but not executed.
+    // - sequence_len: number of tokens to read from the array.
+    // - state: state handle created by rwkv_create_state.
+    // - logits_out: FP32 buffer of size rwkv_get_logits_len(). This buffer will be written to if non-NULL.
+    RWKV_API bool rwkv_eval_sequence_in_state(
+        struct rwkv_context * ctx,
+        const uint32_t * sequence,
+        const size_t sequence_len,
+        struct rwkv_state * state,
+        float * logits_out
+    );
+
+    // Formats of compressed states, see rwkv_compress_state.
+    enum rwkv_state_compression {
+        // Half precision floats. Values outside of FP16 range are clamped.
+        RWKV_STATE_COMPRESSION_FP16 = 0,
+        // 8-bit integers with one FP32 scale per block of values.
+        // For v5+ models, a block is one row of a head state matrix, or the part of a token shift vector that belongs to one head.
+        // For v4 models, a block is one state vector of a layer.
+        RWKV_STATE_COMPRESSION_INT8 = 1
+    };
+
+    // Returns the size in bytes of a state compressed into the format, or 0 if the format is unknown.
+    RWKV_API size_t rwkv_get_compressed_state_size(const struct rwkv_context * ctx, const enum rwkv_state_compression compression);
+
+    // Compresses a state to store idle sessions in less memory.
+    // FP16 halves the size of the state; INT8 makes it about 4 times smaller.
+    // Returns false on any error.
+    // - state: FP32 buffer of size rwkv_get_state_len().
+    // - compressed_state: buffer of size rwkv_get_compressed_state_size().
+    RWKV_API bool rwkv_compress_state(
+        struct rwkv_context * ctx,
+        const float * state,
+        const enum rwkv_state_compression compression,
+        void * compressed_state
+    );
+
+    // Restores a state compressed by rwkv_compress_state. Compression is lossy, so the state is approximately equal to the original.
+    // Returns false on any error.
+    // - compressed_state: buffer of size rwkv_get_compressed_state_size().
+    // - state: FP32 buffer of size rwkv_get_state_len().
+    RWKV_API bool rwkv_decompress_state(
+        struct rwkv_context * ctx,
+        const void * compressed_state,
+        const enum rwkv_state_compression compression,
+        float * state
+    );
+
+    // Sets how many sequence graphs rwkv_eval_sequence keeps built and allocated, one per distinct sequence length.
+    // When the cache is full, the least recently used graph is freed. Graphs over the new limit are freed immediately.
+    // The default is 4. With 0, the last used graph is still kept until a graph of another length is needed.
+    // - ctx: the context to configure.
+    // - cache_size: maximum number of cached sequence graphs.
+    RWKV_API void rwkv_set_sequence_graph_cache_size(struct rwkv_context * ctx, const size_t cache_size);
+
+    // Sets whether rwkv_eval_sequence splits sequences into parts of power-of-two lengths.
+    // For example, a sequence of 13 tokens is evaluated as parts of 8, 4 and 1 tokens.
+    // The state is carried between parts, so results are the same as without bucketing,
+    // but only log2(max sequence length) graphs are ever built, which keeps the graph cache hit rate high
+    // when sequence lengths vary a lot. Disabled by default.
+    // - ctx: the context to configure.
+    // - enabled: whether bucketing should be used.
+    RWKV_API void rwkv_set_sequence_length_bucketing(struct rwkv_context * ctx, const bool enabled);
+
+    // Returns sequence graph cache statistics of the context.
+    // A hit is counted when rwkv_eval_sequence reuses a cached graph, a miss is counted when it has to build a new one.
+    // - hits: receives the hit count. May be NULL.
+    // - misses: receives the miss count. May be NULL.
+    RWKV_API void rwkv_get_sequence_graph_cache_stats(const struct rwkv_context * ctx, uint64_t * hits, uint64_t * misses);
+
+    // Cache of states after common prefixes of evaluated sequences, like system prompts and few-shot preambles.
+    // States are stored in a token trie at chunk boundaries. When the memory budget is exceeded,
+    // least recently used leaf states are evicted.
+    // A cache can be used with any context that shares the model it was created with. It is not thread-safe.
+    struct rwkv_prefix_cache;
+
+    // Creates an empty prefix cache for the model of the context.
+    // Returns NULL on any error. Error messages would be printed to stderr if rwkv_set_print_errors(NULL, true) was called.
+    // The cache must be freed with rwkv_free_prefix_cache.
+    // - max_memory: memory budget of cached states in bytes. Each cached chunk takes about rwkv_get_state_len() * 4 bytes.
+    // - chunk_size: size of each chunk in tokens, must be positive. Prefixes are matched and cached in whole chunks.
+    //   Sequences are also evaluated in chunks of this size, see rwkv_eval_sequence_in_chunks for recommended values.
+    RWKV_API struct rwkv_prefix_cache * rwkv_create_prefix_cache(const struct rwkv_context * ctx, const size_t max_memory, const size_t chunk_size);
+
+    // Frees the prefix cache and all cached states.
+    RWKV_API void rwkv_free_prefix_cache(struct rwkv_prefix_cache * cache);
+
+    // Evaluates the sequence from the initial state, restoring the state after the longest cached prefix
+    // and evaluating only the rest of the sequence. States after every full chunk of the sequence are cached.
+    // If logits are requested, the last token is always evaluated, because logits are not cached.
+    // Not thread-safe. For parallel inference, call rwkv_clone_context to create one rwkv_context for each thread.
+    // Returns false on any error.
+    // - cache: prefix cache created by rwkv_create_prefix_cache for the model of the context.
+    // - sequence: pointer to an array of tokens.
+    // - sequence_len: number of tokens to read from the array.
+    // - state_out: FP32 buffer of size rwkv_get_state_len(). This buffer will be written to if non-NULL.
+    // - logits_out: FP32 buffer of size rwkv_get_logits_len(). This buffer will be written to if non-NULL.
+    RWKV_API bool rwkv_eval_sequence_cached(
+        struct rwkv_context * ctx,
+        struct rwkv_prefix_cache * cache,
+        const uint32_t * sequence,
+        const size_t sequence_len,
+        float * state_out,
+        float * logits_out
+    );
+
+    // Returns prefix cache statistics. Any pointer may be NULL.
+    // - reused_tokens: receives the count of tokens which states were restored from the cache.
+    // - evaluated_tokens: receives the count of tokens that had to be evaluated.
+    // - used_memory: receives the memory currently used by cached states, in bytes.
+    RWKV_API void rwkv_get_prefix_cache_stats(
+        const struct rwkv_prefix_cache * cache,
+        uint64_t * reused_tokens,
+        uint64_t * evaluated_tokens,
+        size_t * used_memory
+    );
+
+    // Samples tokens from logits. Filters are applied in this order: repetition penalties and logit bias, top-k, min-p, top-p,
+    // and then temperature reshapes the probabilities of the remaining tokens. Instead of sorting the whole vocabulary,
+    // top-k uses a partial selection and top-p sorts only as many of the most likely tokens as it keeps.
+    // A sampler can be used with any context of a model with the same vocabulary size. It is not thread-safe.
+    struct rwkv_sampler;
+
+    // Parameters of sampling, see rwkv_create_sampler.
+    // Always start from rwkv_get_default_sampler_params, so that fields added in the future get their default values.
+    struct rwkv_sampler_params {
+        // Must not be negative. Default is 1.0. With 0, the most likely token is always chosen and top-k, min-p and top-p are ignored.
+        float temperature;
+        // Count of most likely tokens to keep; 0 keeps all tokens. Default is 0.
+        uint32_t top_k;
+        // Probability mass of most likely tokens to keep, in range (0, 1]; 1 keeps all tokens. Default is 1.0.
+        float top_p;
+        // Tokens less likely than min_p times the probability of the most likely token are dropped, in range [0, 1]. Default is 0.0.
+        float min_p;
+        // Positive logits of recently accepted tokens are divided by it, negative logits are multiplied by it. Default is 1.0.
+        float repetition_penalty;
+        // Subtracted from logits of recently accepted tokens. Default is 0.0.
+        float presence_penalty;
+        // Subtracted from logits of recently accepted tokens once per occurrence. Default is 0.0.
+        float frequency_penalty;
+        // Count of last accepted tokens that penalties apply to; 0 disables penalties. Default is 64.
+        uint32_t penalty_last_n;
+        // Seed of the random number generator. The same seed and inputs give the same tokens. Default is 0.
+        uint64_t seed;
+    };
+
+    // Returns default sampling parameters.
+    RWKV_API struct rwkv_sampler_params rwkv_get_default_sampler_params(void);
+
+    // Creates a sampler for the vocabulary of the model of the context.
+    // Returns NULL on any error. Error messages would be printed to stderr if rwkv_set_print_errors(NULL, true) was called.
+    // The sampler must be freed with rwkv_free_sampler.
+    RWKV_API struct rwkv_sampler * rwkv_create_sampler(const struct rwkv_context * ctx, const struct rwkv_sampler_params * params);
+
+    // Frees the sampler. Does nothing if sampler is NULL.
+    RWKV_API void rwkv_free_sampler(struct rwkv_sampler * sampler);
+
+    // Replaces the logit bias of the sampler: biases[i] is added to the logit of tokens[i] before sampling.
+    // A bias of -INFINITY bans the token. Passing count 0 removes the bias.
+    // Returns false on any error.
+    RWKV_API bool rwkv_sampler_set_logit_bias(struct rwkv_sampler * sampler, const uint32_t * tokens, const float * biases, const size_t count);
+
+    // Adds the token to the history of the sampler that penalties apply to; use it for prompt tokens.
+    // Sampled tokens are added automatically.
+    // Returns false on any error.
+    RWKV_API bool rwkv_sampler_accept(struct rwkv_sampler * sampler, const uint32_t token);
+
+    // Clears the history of the sampler and reseeds its random number generator.
+    RWKV_API void rwkv_sampler_reset(struct rwkv_sampler * sampler);
+
+    // Samples a token from logits and adds it to the history of the sampler.
+    // - logits: FP32 buffer of size rwkv_get_logits_len().
+    RWKV_API uint32_t rwkv_sampler_sample(struct rwkv_sampler * sampler, const float * logits);
+
+    // Evaluates the model for a single token like rwkv_eval_in_state, and samples the next token from the logits.
+    // Logits never leave the backend when the model head is evaluated on the CPU; only the sampled token is returned.
+    // Not thread-safe. For parallel inference, call rwkv_clone_context to create one rwkv_context for each thread.
+    // Returns false on any error.
+    // - token: next token index, in range 0 <= token < n_vocab.
+    // - state: state handle created by rwkv_create_state.
+    // - sampler: sampler created for a model with the same vocabulary.
+    // - token_out: receives the sampled token.
+    RWKV_API bool rwkv_eval_and_sample(
+        struct rwkv_context * ctx,
+        const uint32_t token,
+        struct rwkv_state * state,
+        struct rwkv_sampler * sampler,
+        uint32_t * token_out
+    );
+
+    // Generates tokens of a target model faster by letting a small draft model with the same vocabulary propose them.
+    // Each round, the draft model proposes k tokens serially, and the target model verifies all of them in one sequence mode pass
+    // that computes logits after every token, see rwkv_eval_sequence_all_logits. Drafted tokens are accepted or replaced by rejection sampling,
+    // so that emitted tokens follow the same distribution as tokens sampled from the target model alone; with temperature 0 they are the same tokens.
+    // When a drafted token is rejected, the target state is restored from a snapshot taken before the round and the accepted prefix is re-evaluated.
+    // Verification and re-evaluation use sequence lengths up to k + 1; consider raising rwkv_set_sequence_graph_cache_size of the target context
+    // to k + 1, or enabling sequence length bucketing, so that graphs are not rebuilt every round.
+    // The decoder keeps the target and draft states itself and uses the contexts only while its functions run. It is not thread-safe.
+    struct rwkv_speculative_decoder;
+
+    // Creates a speculative decoder with initial states.
+    // Returns NULL on any error. Error messages would be printed to stderr if rwkv_set_print_errors(NULL, true) was called.
+    // The decoder must be freed with rwkv_free_speculative_decoder before the contexts are freed.
+    // - draft_length: count of tokens k the draft model proposes per round, must be positive.
+    RWKV_API struct rwkv_speculative_decoder * rwkv_create_speculative_decoder(struct rwkv_context * target_ctx, struct rwkv_context * draft_ctx, const size_t draft_length);
+
+    // Frees the decoder. Does nothing if decoder is NULL.
+    RWKV_API void rwkv_free_speculative_decoder(struct rwkv_speculative_decoder * decoder);
+
+    // Resets the states of the decoder to initial states. Statistics are kept.
+    RWKV_API void rwkv_speculative_reset(struct rwkv_speculative_decoder * decoder);
+
+    // Changes the count of tokens the draft model proposes per round; 0 is treated as 1.
+    RWKV_API void rwkv_set_speculative_draft_length(struct rwkv_speculative_decoder * decoder, const size_t draft_length);
+
+    // Evaluates tokens, like a prompt or user input, with both models. The last token is evaluated by the next rwkv_speculative_decode call.
+    // Tokens are not added to sampler history; use rwkv_sampler_accept for that.
+    // Returns false on any error.
+    // - tokens: pointer to an array of tokens, each in range 0 <= token < n_vocab.
+    // - count: number of tokens to read from the array, must be positive.
+    RWKV_API bool rwkv_speculative_feed(struct rwkv_speculative_decoder * decoder, const uint32_t * tokens, const size_t count);
+
+    // Runs one round of speculative decoding, emitting between 1 and min(k + 1, max_count) tokens.
+    // At least one token must have been fed. Emitted tokens are added to the sampler history and are evaluated by the following rounds.
+    // Returns false on any error.
+    // - sampler: sampler created for a model with the same vocabulary. Its filters apply to both the draft and the target distributions.
+    // - tokens_out: buffer of max_count tokens; receives emitted tokens.
+    // - max_count: size of tokens_out, must be positive. Fewer tokens are drafted if k + 1 tokens would not fit.
+    // - count_out: receives the count of emitted tokens.
+    RWKV_API bool rwkv_speculative_decode(
+        struct rwkv_speculative_decoder * decoder,
+        struct rwkv_sampler * sampler,
+        uint32_t * tokens_out,
+        const size_t max_count,
+        size_t * count_out
+    );
+
+    // Returns statistics of the decoder since creation or rwkv_reset_speculative_stats. Any pointer may be NULL.
+    // accepted_tokens / drafted_tokens is the acceptance rate; generated_tokens / rounds is the count of tokens emitted per target evaluation.
+    // - rounds: receives the count of rwkv_speculative_decode calls.
+    // - drafted_tokens: receives the count of tokens proposed by the draft model.
+    // - accepted_tokens: receives the count of drafted tokens accepted by the target model.
+    // - generated_tokens: receives the count of emitted tokens.
+    RWKV_API void rwkv_get_speculative_stats(
+        const struct rwkv_speculative_decoder * decoder,
+        uint64_t * rounds,
+        uint64_t * drafted_tokens,
+        uint64_t * accepted_tokens,
+        uint64_t * generated_tokens
+    );
+
+    // Copies the counts of rounds in which the drafted token at each position was accepted; useful for choosing k.
+    // A drafted token is only verified if all drafted tokens before it were accepted, so counts never increase with the position.
+    // Returns the count of positions with statistics, which is the largest draft length used.
+    // - counts: buffer of count elements; receives min(count, returned value) elements.
+    RWKV_API size_t rwkv_get_speculative_acceptance_by_position(const struct rwkv_speculative_decoder * decoder, uint64_t * counts, const size_t count);
+
+    // Resets all statistics of the decoder to 0.
+    RWKV_API void rwkv_reset_speculative_stats(struct rwkv_speculative_decoder * decoder);
+
+    // Finds the most likely continuations of a prompt with beam search.
+    // States of live beams are kept in a pool with beam_width slots, allocated once; beams are forked by copying a slot and pruned
+    // by releasing it. Each step evaluates all live beams with one rwkv_eval_batch call, padded to beam_width, so that the batch graph
+    // is built once. Each beam accumulates the log-probability of its tokens; results are ranked by log_prob / length ^ length_penalty.
+    // The search uses the context only while its functions run. It is not thread-safe.
+    struct rwkv_beam_search;
+
+    // Parameters of beam search, see rwkv_create_beam_search.
+    // Always start from rwkv_get_default_beam_search_params, so that fields added in the future get their default values.
+    struct rwkv_beam_search_params {
+        // Count of live beams and of kept results, must be positive and at most n_vocab. Default is 4.
+        uint32_t beam_width;
+        // Count of generated tokens after which a beam ends, must be positive. Default is 32.
+        uint32_t max_tokens;
+        // Exponent of the length that log-probabilities of results are divided by; 0 ranks by log-probability alone,
+        // larger values favor longer results. Default is 1.0.
+        float length_penalty;
+        // Token that ends a beam; it is included in the result. -1 disables it. Default is -1.
+        int32_t end_token;
+    };
+
+    // Returns default beam search parameters.
+    RWKV_API struct rwkv_beam_search_params rwkv_get_default_beam_search_params(void);
+
+    // Creates a beam search for the model of the context. The search must be freed with rwkv_free_beam_search before the context is freed.
+    // Returns NULL on any error. Error messages would be printed to stderr if rwkv_set_print_errors(NULL, true) was called.
+    RWKV_API struct rwkv_beam_search * rwkv_create_beam_search(struct rwkv_context * ctx, const struct rwkv_beam_search_params * params);
+
+    // Frees the beam search. Does nothing if search is NULL.
+    RWKV_API void rwkv_free_beam_search(struct rwkv_beam_search * search);
+
+    // Starts a new search from the prompt, discarding beams and results of the previous search.
+    // Returns false on any error.
+    // - prompt: pointer to an array of tokens, each in range 0 <= token < n_vocab.
+    // - prompt_len: number of tokens to read from the array, must be positive.
+    // - state_in: FP32 buffer of size rwkv_get_state_len() with the state before the prompt, or NULL to start from the initial state.
+    RWKV_API bool rwkv_beam_search_start(struct rwkv_beam_search * search, const uint32_t * prompt, const size_t prompt_len, const float * state_in);
+
+    // Advances all live beams by one token, keeping the beam_width most likely continuations.
+    // Returns false on any error.
+    // - done_out: receives whether the search has ended, because no live beam can be better than the kept results. May be NULL.
+    RWKV_API bool rwkv_beam_search_step(struct rwkv_beam_search * search, bool * done_out);
+
+    // Calls rwkv_beam_search_step until the search ends.
+    // Returns false on any error.
+    RWKV_API bool rwkv_beam_search_run(struct rwkv_beam_search * search);
+
+    // Returns the count of results, at most beam_width. Results are kept while the search runs, so this may grow between steps.
+    RWKV_API size_t rwkv_beam_search_get_result_count(const struct rwkv_beam_search * search);
+
+    // Copies a result. Results are sorted by score, the best one first. Any output pointer may be NULL.
+    // Returns false on any error.
+    // - index: index of the result, less than rwkv_beam_search_get_result_count.
+    // - tokens_out: buffer of max_tokens tokens; receives the first min(max_tokens, length) generated tokens.
+    // - length_out: receives the count of generated tokens of the result.
+    // - log_prob_out: receives the natural logarithm of the probability of the generated tokens.
+    // - score_out: receives the score that results are ranked by.
+    RWKV_API bool rwkv_beam_search_get_result(
+        const struct rwkv_beam_search * search,
+        const size_t index,
+        uint32_t * tokens_out,
+        const size_t max_tokens,
+        size_t * length_out,
+        float * log_prob_out,
+        float * score_out
+    );
+
     // Returns the number of tokens in the given model's vocabulary.
     // Useful for telling 20B_tokenizer models (n_vocab = 50277) apart from World models (n_vocab = 65536).
     RWKV_API size_t rwkv_get_n_vocab(const struct rwkv_context * ctx);
@@ -204,6 +806,24 @@ extern "C" {
     // Does not need to be called on the same thread that created the rwkv_context.
     RWKV_API void rwkv_free(struct rwkv_context * ctx);
 
+    // Starts collecting an importance matrix for quantization: mean squares of activations of each column of each model matrix.
+    // All following evaluations of the context add to the statistics, so evaluate calibration text with rwkv_eval_sequence_in_chunks
+    // or other eval functions, then write the statistics with rwkv_save_imatrix. Statistics of the model head are only collected
+    // by evaluations that compute logits. Evaluation is slower while statistics are collected.
+    // Calling this function again discards already collected statistics.
+    // Returns false on any error.
+    RWKV_API bool rwkv_start_imatrix_collection(struct rwkv_context * ctx);
+
+    // Writes the importance matrix collected since rwkv_start_imatrix_collection to a file,
+    // which can be passed to rwkv_quantize_model_file_with_params as rwkv_quantize_params.imatrix.
+    // Collection continues after writing.
+    // Returns false on any error.
+    // - file_path: path to the file, will be overwritten.
+    RWKV_API bool rwkv_save_imatrix(struct rwkv_context * ctx, const char * file_path);
+
+    // Stops collecting the importance matrix and discards collected statistics.
+    RWKV_API void rwkv_stop_imatrix_collection(struct rwkv_context * ctx);
+
     // Quantizes FP32 or FP16 model to one of quantized formats.
     // Returns false on any error. Error messages would be printed to stderr.
     // - model_file_path_in: path to model file in ggml format, must be either FP32 or FP16.
@@ -215,8 +835,46 @@ extern "C" {
     // - Q5_0
     // - Q5_1
     // - Q8_0
+    // - Q2_K, Q3_K, Q4_K, Q5_K and Q6_K; matrices with rows that are not a multiple of 256 elements keep their data type.
     RWKV_API bool rwkv_quantize_model_file(const char * model_file_path_in, const char * model_file_path_out, const char * format_name);
 
+    // Parameters of quantization, see rwkv_quantize_model_file_with_params.
+    // Always start from rwkv_get_default_quantize_params, so that fields added in the future get their default values.
+    struct rwkv_quantize_params {
+        // Count of threads quantizing each matrix, must be positive. Default is 1.
+        // Matrices are split into ranges of rows quantized in parallel.
+        // Reading and writing of neighbour tensors always overlaps with quantization, regardless of this value.
+        uint32_t n_threads;
+        // Per-tensor data types, as a comma-separated list of rules "PATTERN[@LAYERS]=TYPE"; or NULL. Default is NULL.
+        // Without rules, 2D matrices except embedding, head and v7 low-rank matrices are quantized to format_name,
+        // and other tensors keep their data type.
+        // - PATTERN selects matrices whose name contains it, for example "ffn.key", "att.output", "head" or "emb".
+        //   "*" selects all matrices that are quantized by default.
+        // - LAYERS optionally limits the rule to "first:N" layers, "last:N" layers, layer "N" or layers "N-M".
+        //   PATTERN can be omitted when LAYERS is present, which selects the same matrices as "*".
+        // - TYPE is FP32, FP16 or a quantized format, including K-quants Q2_K, Q3_K, Q4_K, Q5_K and Q6_K.
+        // When several rules match a matrix, the last one wins. Matrices whose rows are not a multiple of the block size of TYPE
+        // keep their data type. Example: "ffn.key=Q4_K, att.output=Q6_K, head=Q8_0, @first:2=Q8_0, @last:2=Q8_0".
+        const char * policy;
+        // Path to an importance matrix file written by rwkv_save_imatrix, or NULL. Default is NULL.
+        // Quantization then minimizes errors weighted by the importance of each matrix column, which helps low-bit formats
+        // like Q3_K and Q4_K the most. Matrices without statistics in the file are quantized as without an importance matrix.
+        const char * imatrix;
+    };
+
+    // Returns default quantization parameters.
+    RWKV_API struct rwkv_quantize_params rwkv_get_default_quantize_params(void);
+
+    // Quantizes FP32 or FP16 model to one of quantized formats, like rwkv_quantize_model_file, but with more parameters.
+    // Returns false on any error. Error messages would be printed to stderr.
+    // - params: quantization parameters; start from rwkv_get_default_quantize_params.
+    RWKV_API bool rwkv_quantize_model_file_with_params(
+        const char * model_file_path_in,
+        const char * model_file_path_out,
+        const char * format_name,
+        const struct rwkv_quantize_params * params
+    );
+
     // Returns system information string.
     RWKV_API const char * rwkv_get_system_info_string(void);
 
@@ -0,0 +1,87 @@
+// Tests that thread count overrides and auto-tuning do not change results, and that chunk size 0 uses the tuned chunk size.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <rwkv.h>
+
+#include "assertions.inc"
+#include "tiny_rwkv_versions.inc"
+
+#define SEQUENCE_LENGTH 40
+#define MAX_THREADS 2
+
+// Thread count changes how matrix multiplications are split, but not what they compute.
+#define MAX_DIFF 0.0001F
+
+void test_model(const char * version) {
+    char file_name[128];
+    snprintf(file_name, sizeof(file_name), "tiny-rwkv-%s-FP32.bin", version);
+
+    fprintf(stderr, "Testing %s\n", file_name);
+
+    struct rwkv_context * ctx = rwkv_init_from_file(file_name, 2, 0);
+
+    ASSERT(ctx != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    const size_t state_len = rwkv_get_state_len(ctx);
+    const size_t logits_len = rwkv_get_logits_len(ctx);
+
+    float * state = calloc(state_len, sizeof(float));
+    float * expected_logits = calloc(logits_len, sizeof(float));
+    float * logits = calloc(logits_len, sizeof(float));
+
+    uint32_t tokens[SEQUENCE_LENGTH];
+
+    for (int i = 0; i < SEQUENCE_LENGTH; i++) {
+        tokens[i] = (uint32_t) (i * 3 + 1);
+    }
+
+    ASSERT(rwkv_eval_sequence_in_chunks(ctx, tokens, SEQUENCE_LENGTH, 16, NULL, state, expected_logits), "Unexpected error 0x%.8X", rwkv_get_last_error(ctx));
+
+    // An untuned context uses the default chunk size.
+    ASSERT(rwkv_eval_sequence_in_chunks(ctx, tokens, SEQUENCE_LENGTH, 0, NULL, state, logits), "Unexpected error 0x%.8X", rwkv_get_last_error(ctx));
+    ASSERT_MAX_ABS_DIFF(expected_logits, logits, logits_len, MAX_DIFF, "Default chunk size");
+
+    rwkv_set_n_threads(ctx, 1, 3);
+    ASSERT(rwkv_eval_sequence_in_chunks(ctx, tokens, SEQUENCE_LENGTH, 16, NULL, state, logits), "Unexpected error 0x%.8X", rwkv_get_last_error(ctx));
+    ASSERT_MAX_ABS_DIFF(expected_logits, logits, logits_len, MAX_DIFF, "Overridden thread counts");
+
+    size_t chunk_size = 0;
+    uint32_t serial_n_threads = 0;
+    uint32_t sequence_n_threads = 0;
+
+    ASSERT(rwkv_auto_tune(ctx, MAX_THREADS, &chunk_size, &serial_n_threads, &sequence_n_threads), "Unexpected error 0x%.8X", rwkv_get_last_error(ctx));
+
+    fprintf(stderr, "Chunk size %d, serial threads %d, sequence threads %d\n", (int) chunk_size, (int) serial_n_threads, (int) sequence_n_threads);
+
+    ASSERT(chunk_size >= 4 && chunk_size <= 64, "Unexpected chunk size %d", (int) chunk_size);
+    ASSERT(serial_n_threads >= 1 && serial_n_threads <= MAX_THREADS, "Unexpected serial thread count %d", (int) serial_n_threads);
+    ASSERT(sequence_n_threads >= 1 && sequence_n_threads <= MAX_THREADS, "Unexpected sequence thread count %d", (int) sequence_n_threads);
+
+    // Chunk size 0 evaluates the same chunks as the tuned chunk size.
+    float * tuned_logits = calloc(logits_len, sizeof(float));
+
+    ASSERT(rwkv_eval_sequence_in_chunks(ctx, tokens, SEQUENCE_LENGTH, chunk_size, NULL, state, tuned_logits), "Unexpected error 0x%.8X", rwkv_get_last_error(ctx));
+    ASSERT(rwkv_eval_sequence_in_chunks(ctx, tokens, SEQUENCE_LENGTH, 0, NULL, state, logits), "Unexpected error 0x%.8X", rwkv_get_last_error(ctx));
+    ASSERT(memcmp(tuned_logits, logits, logits_len * sizeof(float)) == 0, "Chunk size 0 did not use the tuned chunk size");
+
+    // The chunk size does not change the result beyond rounding.
+    ASSERT_MAX_ABS_DIFF(expected_logits, logits, logits_len, MAX_DIFF, "Tuned chunk size");
+
+    rwkv_free(ctx);
+
+    free(tuned_logits);
+    free(logits);
+    free(expected_logits);
+    free(state);
+}
+
+int main(void) {
+    for (int i = 0; i < TINY_RWKV_VERSION_COUNT; i++) {
+        test_model(tiny_rwkv_versions[i]);
+    }
+
+    return 0;
+}
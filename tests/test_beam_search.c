@@ -0,0 +1,168 @@
+// Tests that beam search of width 1 is greedy decoding, and that log-probabilities of results match serial evaluation.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <rwkv.h>
+
+#include "assertions.inc"
+#include "tiny_rwkv_versions.inc"
+
+#define PROMPT_LENGTH 4
+#define MAX_TOKENS 6
+#define BEAM_WIDTH 3
+
+// Batched evaluation accumulates in a different order than serial evaluation.
+#define MAX_DIFF 0.001F
+
+static uint32_t argmax(const float * logits, const size_t length) {
+    uint32_t best = 0;
+
+    for (size_t i = 1; i < length; i++) {
+        if (logits[i] > logits[best]) {
+            best = (uint32_t) i;
+        }
+    }
+
+    return best;
+}
+
+static float log_softmax(const float * logits, const size_t length, const uint32_t token) {
+    float max_logit = logits[0];
+
+    for (size_t i = 1; i < length; i++) {
+        max_logit = logits[i] > max_logit ? logits[i] : max_logit;
+    }
+
+    double sum = 0.0;
+
+    for (size_t i = 0; i < length; i++) {
+        sum += exp((double) (logits[i] - max_logit));
+    }
+
+    return (float) ((double) (logits[token] - max_logit) - log(sum));
+}
+
+void test_model(const char * version) {
+    char file_name[128];
+    snprintf(file_name, sizeof(file_name), "tiny-rwkv-%s-FP32.bin", version);
+
+    fprintf(stderr, "Testing %s\n", file_name);
+
+    struct rwkv_context * ctx = rwkv_init_from_file(file_name, 2, 0);
+
+    ASSERT(ctx != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    const size_t state_len = rwkv_get_state_len(ctx);
+    const size_t logits_len = rwkv_get_logits_len(ctx);
+
+    float * prompt_state = calloc(state_len, sizeof(float));
+    float * state = calloc(state_len, sizeof(float));
+    float * prompt_logits = calloc(logits_len, sizeof(float));
+    float * logits = calloc(logits_len, sizeof(float));
+
+    ASSERT(prompt_state != NULL && state != NULL, "Failed to allocate state");
+    ASSERT(prompt_logits != NULL && logits != NULL, "Failed to allocate logits");
+
+    const uint32_t prompt[PROMPT_LENGTH] = { '"', 'h', 'e', 'y' };
+
+    for (int i = 0; i < PROMPT_LENGTH; i++) {
+        ASSERT(rwkv_eval(ctx, prompt[i], i == 0 ? NULL : prompt_state, prompt_state, prompt_logits), "rwkv_eval failed");
+    }
+
+    // Width 1 keeps the most likely token at every step.
+    struct rwkv_beam_search_params params = rwkv_get_default_beam_search_params();
+    params.beam_width = 1;
+    params.max_tokens = MAX_TOKENS;
+
+    struct rwkv_beam_search * search = rwkv_create_beam_search(ctx, &params);
+
+    ASSERT(search != NULL, "rwkv_create_beam_search failed with error 0x%.8X", rwkv_get_last_error(NULL));
+    ASSERT(rwkv_beam_search_start(search, prompt, PROMPT_LENGTH, NULL), "rwkv_beam_search_start failed");
+    ASSERT(rwkv_beam_search_run(search), "rwkv_beam_search_run failed");
+    ASSERT(rwkv_beam_search_get_result_count(search) == 1, "Unexpected result count");
+
+    uint32_t tokens[MAX_TOKENS];
+    size_t length;
+    ASSERT(rwkv_beam_search_get_result(search, 0, tokens, MAX_TOKENS, &length, NULL, NULL), "rwkv_beam_search_get_result failed");
+    ASSERT(length == MAX_TOKENS, "Unexpected result length %d", (int) length);
+
+    memcpy(state, prompt_state, state_len * sizeof(float));
+    memcpy(logits, prompt_logits, logits_len * sizeof(float));
+
+    for (int i = 0; i < MAX_TOKENS; i++) {
+        ASSERT(tokens[i] == argmax(logits, logits_len), "Token %d is not the most likely one", i);
+        ASSERT(rwkv_eval(ctx, tokens[i], state, state, logits), "rwkv_eval failed");
+    }
+
+    rwkv_free_beam_search(search);
+
+    // Wider beams end on the end token or at the token limit, and report log-probabilities of their tokens.
+    params.beam_width = BEAM_WIDTH;
+    params.end_token = ' ';
+
+    search = rwkv_create_beam_search(ctx, &params);
+
+    ASSERT(search != NULL, "rwkv_create_beam_search failed with error 0x%.8X", rwkv_get_last_error(NULL));
+
+    // Starting from the state after all prompt tokens but the last one is the same as starting from the whole prompt.
+    ASSERT(rwkv_eval_sequence(ctx, prompt, PROMPT_LENGTH - 1, NULL, state, NULL), "rwkv_eval_sequence failed");
+    ASSERT(rwkv_beam_search_start(search, prompt + PROMPT_LENGTH - 1, 1, state), "rwkv_beam_search_start failed");
+    ASSERT(rwkv_beam_search_run(search), "rwkv_beam_search_run failed");
+
+    const size_t result_count = rwkv_beam_search_get_result_count(search);
+    ASSERT(result_count >= 1 && result_count <= BEAM_WIDTH, "Unexpected result count %d", (int) result_count);
+
+    float previous_score = INFINITY;
+
+    for (size_t r = 0; r < result_count; r++) {
+        float log_prob;
+        float score;
+        ASSERT(rwkv_beam_search_get_result(search, r, tokens, MAX_TOKENS, &length, &log_prob, &score), "rwkv_beam_search_get_result failed");
+
+        ASSERT(score <= previous_score, "Results are not sorted by score");
+        ASSERT(length == MAX_TOKENS || tokens[length - 1] == ' ', "Result %d ended early without the end token", (int) r);
+        ASSERT(fabsf(score - log_prob / (float) length) <= MAX_DIFF, "Score of result %d is not length normalized", (int) r);
+
+        previous_score = score;
+
+        memcpy(state, prompt_state, state_len * sizeof(float));
+        memcpy(logits, prompt_logits, logits_len * sizeof(float));
+
+        float expected_log_prob = 0.0F;
+
+        for (size_t i = 0; i < length; i++) {
+            ASSERT(i + 1 == length || tokens[i] != ' ', "Result %d continues after the end token", (int) r);
+
+            expected_log_prob += log_softmax(logits, logits_len, tokens[i]);
+
+            ASSERT(rwkv_eval(ctx, tokens[i], state, state, logits), "rwkv_eval failed");
+        }
+
+        const float diff = fabsf(expected_log_prob - log_prob);
+        ASSERT(diff <= MAX_DIFF, "Log-probability of result %d differs by %f", (int) r, (double) diff);
+    }
+
+    ASSERT(!rwkv_beam_search_get_result(search, result_count, tokens, MAX_TOKENS, &length, NULL, NULL), "Out of range result index was accepted");
+
+    rwkv_free_beam_search(search);
+
+    params.beam_width = 0;
+    ASSERT(rwkv_create_beam_search(ctx, &params) == NULL, "Beam width 0 was accepted");
+
+    rwkv_free(ctx);
+
+    free(logits);
+    free(prompt_logits);
+    free(state);
+    free(prompt_state);
+}
+
+int main(void) {
+    for (int i = 0; i < TINY_RWKV_VERSION_COUNT; i++) {
+        test_model(tiny_rwkv_versions[i]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,131 @@
+// Tests that rwkv_eval_batch gives results equivalent to serial eval of each sequence.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <rwkv.h>
+
+#include "assertions.inc"
+#include "tiny_rwkv_versions.inc"
+
+#define BATCH_SIZE 3
+#define TOKEN_COUNT 5
+
+// Batched matrix multiplication may accumulate in a different order than matrix-vector multiplication.
+#define MAX_DIFF 0.001F
+
+void test_model(const char * version) {
+    char file_name[128];
+    snprintf(file_name, sizeof(file_name), "tiny-rwkv-%s-FP32.bin", version);
+
+    fprintf(stderr, "Testing %s\n", file_name);
+
+    struct rwkv_context * ctx = rwkv_init_from_file(file_name, 2, 0);
+
+    ASSERT(ctx != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    const size_t state_len = rwkv_get_state_len(ctx);
+    const size_t logits_len = rwkv_get_logits_len(ctx);
+
+    const char prompts[BATCH_SIZE][TOKEN_COUNT + 1] = {
+        "hello",
+        "world",
+        "\"in a"
+    };
+
+    float * expected_states[BATCH_SIZE];
+    float * expected_logits[BATCH_SIZE];
+    float * states[BATCH_SIZE];
+    float * logits[BATCH_SIZE];
+
+    for (int b = 0; b < BATCH_SIZE; b++) {
+        expected_states[b] = calloc(state_len, sizeof(float));
+        expected_logits[b] = calloc(logits_len, sizeof(float));
+        states[b] = calloc(state_len, sizeof(float));
+        logits[b] = calloc(logits_len, sizeof(float));
+
+        ASSERT(expected_states[b] != NULL && states[b] != NULL, "Failed to allocate state");
+        ASSERT(expected_logits[b] != NULL && logits[b] != NULL, "Failed to allocate logits");
+
+        rwkv_eval(ctx, prompts[b][0], NULL, expected_states[b], expected_logits[b]);
+
+        for (int t = 1; t < TOKEN_COUNT; t++) {
+            rwkv_eval(ctx, prompts[b][t], expected_states[b], expected_states[b], expected_logits[b]);
+        }
+    }
+
+    uint32_t tokens[BATCH_SIZE];
+
+    for (int t = 0; t < TOKEN_COUNT; t++) {
+        for (int b = 0; b < BATCH_SIZE; b++) {
+            tokens[b] = prompts[b][t];
+        }
+
+        // On the first step, states are initialized by passing NULL.
+        ASSERT(
+            rwkv_eval_batch(ctx, tokens, BATCH_SIZE, t == 0 ? NULL : (const float * const *) states, states, logits),
+            "rwkv_eval_batch failed with error 0x%.8X",
+            rwkv_get_last_error(ctx)
+        );
+    }
+
+    for (int b = 0; b < BATCH_SIZE; b++) {
+        float state_diff = max_abs_diff(expected_states[b], states[b], state_len);
+        float logits_diff = max_abs_diff(expected_logits[b], logits[b], logits_len);
+
+        fprintf(stderr, "Sequence %d: max state difference %f, max logit difference %f\n", b, (double) state_diff, (double) logits_diff);
+
+        ASSERT(state_diff <= MAX_DIFF, "Too big state difference %f", (double) state_diff);
+        ASSERT(logits_diff <= MAX_DIFF, "Too big logit difference %f", (double) logits_diff);
+    }
+
+    // Alternating between batch sizes switches between cached graphs without changing results.
+    for (int b = 0; b < BATCH_SIZE; b++) {
+        tokens[b] = '.';
+    }
+
+    ASSERT(rwkv_eval_batch(ctx, tokens, BATCH_SIZE, (const float * const *) states, NULL, expected_logits), "rwkv_eval_batch failed with error 0x%.8X", rwkv_get_last_error(ctx));
+
+    for (int i = 0; i < 2; i++) {
+        ASSERT(rwkv_eval_batch(ctx, tokens, BATCH_SIZE - 1, (const float * const *) states, NULL, logits), "rwkv_eval_batch failed with error 0x%.8X", rwkv_get_last_error(ctx));
+
+        for (int b = 0; b < BATCH_SIZE - 1; b++) {
+            float logits_diff = max_abs_diff(expected_logits[b], logits[b], logits_len);
+            ASSERT(logits_diff <= MAX_DIFF, "Batch size %d changed logits of sequence %d by %f", BATCH_SIZE - 1, b, (double) logits_diff);
+        }
+
+        ASSERT(rwkv_eval_batch(ctx, tokens, BATCH_SIZE, (const float * const *) states, NULL, logits), "rwkv_eval_batch failed with error 0x%.8X", rwkv_get_last_error(ctx));
+
+        for (int b = 0; b < BATCH_SIZE; b++) {
+            ASSERT(memcmp(expected_logits[b], logits[b], logits_len * sizeof(float)) == 0, "Cached batch graph changed logits of sequence %d", b);
+        }
+    }
+
+    // An array of NULL logit buffers skips logits without changing states.
+    float * no_logits[BATCH_SIZE] = { NULL };
+
+    ASSERT(rwkv_eval_batch(ctx, tokens, BATCH_SIZE, (const float * const *) states, expected_states, logits), "rwkv_eval_batch failed with error 0x%.8X", rwkv_get_last_error(ctx));
+    ASSERT(rwkv_eval_batch(ctx, tokens, BATCH_SIZE, (const float * const *) states, states, no_logits), "rwkv_eval_batch failed with error 0x%.8X", rwkv_get_last_error(ctx));
+
+    for (int b = 0; b < BATCH_SIZE; b++) {
+        ASSERT(memcmp(expected_states[b], states[b], state_len * sizeof(float)) == 0, "Skipping logits changed state of sequence %d", b);
+    }
+
+    rwkv_free(ctx);
+
+    for (int b = 0; b < BATCH_SIZE; b++) {
+        free(expected_states[b]);
+        free(expected_logits[b]);
+        free(states[b]);
+        free(logits[b]);
+    }
+}
+
+int main(void) {
+    for (int i = 0; i < TINY_RWKV_VERSION_COUNT; i++) {
+        test_model(tiny_rwkv_versions[i]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+// Tests that logits of every token of a sequence and log-probabilities of targets match serial evaluation.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <rwkv.h>
+
+#include "assertions.inc"
+#include "tiny_rwkv_versions.inc"
+
+#define FORMAT_COUNT 3
+#define TOKEN_COUNT 7
+#define CHUNK_SIZE 3
+
+// Sequence mode accumulates in a different order than serial mode.
+#define MAX_DIFF 0.001F
+
+void test_model(const char * version, const char * format) {
+    char file_name[128];
+    snprintf(file_name, sizeof(file_name), "tiny-rwkv-%s-%s.bin", version, format);
+
+    fprintf(stderr, "Testing %s\n", file_name);
+
+    struct rwkv_context * ctx = rwkv_init_from_file(file_name, 2, 0);
+
+    ASSERT(ctx != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    const size_t state_len = rwkv_get_state_len(ctx);
+    const size_t logits_len = rwkv_get_logits_len(ctx);
+
+    float * expected_state = calloc(state_len, sizeof(float));
+    float * expected_logits = calloc(TOKEN_COUNT * logits_len, sizeof(float));
+    float * state = calloc(state_len, sizeof(float));
+    float * logits = calloc(TOKEN_COUNT * logits_len, sizeof(float));
+
+    ASSERT(expected_state != NULL && state != NULL, "Failed to allocate state");
+    ASSERT(expected_logits != NULL && logits != NULL, "Failed to allocate logits");
+
+    const uint32_t tokens[TOKEN_COUNT + 1] = { '"', 'h', 'e', 'l', 'l', 'o', ' ', 'w' };
+
+    for (int i = 0; i < TOKEN_COUNT; i++) {
+        ASSERT(rwkv_eval(ctx, tokens[i], i == 0 ? NULL : expected_state, expected_state, expected_logits + i * logits_len), "rwkv_eval failed");
+    }
+
+    ASSERT(rwkv_eval_sequence_all_logits(ctx, tokens, TOKEN_COUNT, NULL, state, logits), "rwkv_eval_sequence_all_logits failed");
+
+    for (int i = 0; i < TOKEN_COUNT; i++) {
+        for (size_t j = 0; j < logits_len; j++) {
+            const float diff = fabsf(expected_logits[i * logits_len + j] - logits[i * logits_len + j]);
+            ASSERT(diff <= MAX_DIFF, "Logit %d of token %d differs by %f", (int) j, i, (double) diff);
+        }
+    }
+
+    for (size_t j = 0; j < state_len; j++) {
+        const float diff = fabsf(expected_state[j] - state[j]);
+        ASSERT(diff <= MAX_DIFF, "State element %d differs by %f", (int) j, (double) diff);
+    }
+
+    // The last row must match what rwkv_eval_sequence computes for the last token.
+    ASSERT(rwkv_eval_sequence(ctx, tokens, TOKEN_COUNT, NULL, state, expected_logits), "rwkv_eval_sequence failed");
+
+    for (size_t j = 0; j < logits_len; j++) {
+        const float diff = fabsf(expected_logits[j] - logits[(TOKEN_COUNT - 1) * logits_len + j]);
+        ASSERT(diff <= MAX_DIFF, "Logit %d of the last token differs by %f", (int) j, (double) diff);
+    }
+
+    // Chunks shorter than the sequence carry the state over.
+    float log_probs[TOKEN_COUNT];
+    ASSERT(rwkv_eval_sequence_log_probs(ctx, tokens, tokens + 1, TOKEN_COUNT, CHUNK_SIZE, NULL, state, log_probs), "rwkv_eval_sequence_log_probs failed");
+
+    ASSERT(rwkv_eval_sequence_all_logits(ctx, tokens, TOKEN_COUNT, NULL, NULL, logits), "rwkv_eval_sequence_all_logits failed");
+
+    for (int i = 0; i < TOKEN_COUNT; i++) {
+        const float * row = logits + i * logits_len;
+
+        float max_logit = row[0];
+
+        for (size_t j = 1; j < logits_len; j++) {
+            max_logit = row[j] > max_logit ? row[j] : max_logit;
+        }
+
+        double sum = 0.0;
+
+        for (size_t j = 0; j < logits_len; j++) {
+            sum += exp((double) (row[j] - max_logit));
+        }
+
+        const float expected_log_prob = (float) ((double) (row[tokens[i + 1]] - max_logit) - log(sum));
+        const float diff = fabsf(expected_log_prob - log_probs[i]);
+        ASSERT(diff <= MAX_DIFF, "Log-probability of target %d differs by %f", i, (double) diff);
+        ASSERT(log_probs[i] <= 0.0F, "Log-probability of target %d is positive", i);
+    }
+
+    const uint32_t out_of_range = (uint32_t) logits_len;
+    ASSERT(!rwkv_eval_sequence_log_probs(ctx, tokens, &out_of_range, 1, CHUNK_SIZE, NULL, NULL, log_probs), "Out of range target was accepted");
+    ASSERT(!rwkv_eval_sequence_log_probs(ctx, tokens, tokens + 1, TOKEN_COUNT, 0, NULL, NULL, log_probs), "Chunk size 0 was accepted");
+
+    rwkv_free(ctx);
+
+    free(logits);
+    free(state);
+    free(expected_logits);
+    free(expected_state);
+}
+
+int main(void) {
+    const char * formats[FORMAT_COUNT] = {
+        "FP32",
+        "FP16",
+        "Q5_1"
+    };
+
+    for (int i = 0; i < TINY_RWKV_VERSION_COUNT; i++) {
+        for (int j = 0; j < FORMAT_COUNT; j++) {
+            test_model(tiny_rwkv_versions[i], formats[j]);
+        }
+    }
+
+    return 0;
+}
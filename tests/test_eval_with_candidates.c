@@ -0,0 +1,89 @@
+// Tests that logits of candidate tokens are equal to the same logits computed for the whole vocabulary.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <rwkv.h>
+
+#include "assertions.inc"
+#include "tiny_rwkv_versions.inc"
+
+#define FORMAT_COUNT 3
+#define CANDIDATE_COUNT 5
+#define TOKEN_COUNT 4
+
+// Matrix multiplication may accumulate in a different order than a single dot product; sequence mode differs from serial mode.
+#define MAX_DIFF 0.001F
+
+void test_model(const char * version, const char * format) {
+    char file_name[128];
+    snprintf(file_name, sizeof(file_name), "tiny-rwkv-%s-%s.bin", version, format);
+
+    fprintf(stderr, "Testing %s\n", file_name);
+
+    struct rwkv_context * ctx = rwkv_init_from_file(file_name, 2, 0);
+
+    ASSERT(ctx != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    const size_t state_len = rwkv_get_state_len(ctx);
+    const size_t logits_len = rwkv_get_logits_len(ctx);
+
+    float * expected_state = calloc(state_len, sizeof(float));
+    float * expected_logits = calloc(logits_len, sizeof(float));
+    float * state = calloc(state_len, sizeof(float));
+
+    ASSERT(expected_state != NULL && state != NULL, "Failed to allocate state");
+    ASSERT(expected_logits != NULL, "Failed to allocate logits");
+
+    // Includes the first and the last token of the vocabulary and a repeated token.
+    const uint32_t candidates[CANDIDATE_COUNT] = { 0, 'a', (uint32_t) logits_len - 1, 'z', 'a' };
+    float logits[CANDIDATE_COUNT];
+
+    const uint32_t tokens[TOKEN_COUNT] = { '"', 'h', 'e', 'y' };
+
+    for (int i = 0; i < TOKEN_COUNT; i++) {
+        ASSERT(rwkv_eval(ctx, tokens[i], i == 0 ? NULL : expected_state, expected_state, expected_logits), "rwkv_eval failed");
+        ASSERT(rwkv_eval_with_candidates(ctx, tokens[i], i == 0 ? NULL : state, state, candidates, CANDIDATE_COUNT, logits), "rwkv_eval_with_candidates failed");
+
+        ASSERT(memcmp(expected_state, state, state_len * sizeof(float)) == 0, "States are not identical");
+
+        for (int j = 0; j < CANDIDATE_COUNT; j++) {
+            const float diff = fabsf(expected_logits[candidates[j]] - logits[j]);
+            ASSERT(diff <= MAX_DIFF, "Logit of token %d differs by %f", (int) candidates[j], (double) diff);
+        }
+    }
+
+    ASSERT(rwkv_eval_sequence(ctx, tokens, TOKEN_COUNT, NULL, expected_state, expected_logits), "rwkv_eval_sequence failed");
+    ASSERT(rwkv_eval_sequence_with_candidates(ctx, tokens, TOKEN_COUNT, NULL, state, candidates, CANDIDATE_COUNT, logits), "rwkv_eval_sequence_with_candidates failed");
+
+    for (int j = 0; j < CANDIDATE_COUNT; j++) {
+        const float diff = fabsf(expected_logits[candidates[j]] - logits[j]);
+        ASSERT(diff <= MAX_DIFF, "Logit of token %d differs by %f in sequence mode", (int) candidates[j], (double) diff);
+    }
+
+    const uint32_t out_of_range = (uint32_t) logits_len;
+    ASSERT(!rwkv_eval_with_candidates(ctx, tokens[0], NULL, NULL, &out_of_range, 1, logits), "Out of range candidate was accepted");
+
+    rwkv_free(ctx);
+
+    free(state);
+    free(expected_logits);
+    free(expected_state);
+}
+
+int main(void) {
+    const char * formats[FORMAT_COUNT] = {
+        "FP32",
+        "FP16",
+        "Q5_1"
+    };
+
+    for (int i = 0; i < TINY_RWKV_VERSION_COUNT; i++) {
+        for (int j = 0; j < FORMAT_COUNT; j++) {
+            test_model(tiny_rwkv_versions[i], formats[j]);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+// Tests that quantized models are written in the latest file version, with architecture metadata and aligned tensor data.
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include <rwkv.h>
+
+#include "assertions.inc"
+#include "tiny_rwkv_versions.inc"
+
+// Size of a tensor index entry without the name and the offset, for each dimension count.
+#define ENTRY_HEADER_SIZE(dim_count) (sizeof(uint32_t) * (3 + (dim_count)))
+
+void test_model(const char * version, const uint32_t expected_major, const uint32_t expected_minor) {
+    char source_file_name[128];
+    char quantized_file_name[128];
+    snprintf(source_file_name, sizeof(source_file_name), "tiny-rwkv-%s-FP32.bin", version);
+    snprintf(quantized_file_name, sizeof(quantized_file_name), "tiny-rwkv-%s-FP32-Q5_1-indexed.bin", version);
+
+    fprintf(stderr, "Testing %s\n", quantized_file_name);
+
+    ASSERT(rwkv_quantize_model_file(source_file_name, quantized_file_name, "Q5_1"), "Failed to quantize %s", source_file_name);
+
+    FILE * file = fopen(quantized_file_name, "rb");
+    ASSERT(file != NULL, "Failed to open %s", quantized_file_name);
+
+    uint32_t header[6];
+    ASSERT(fread(header, sizeof(header), 1, file) == 1, "Failed to read file header");
+    ASSERT(header[0] == RWKV_FILE_MAGIC, "Unexpected magic 0x%.8X", header[0]);
+    ASSERT(header[1] == RWKV_FILE_VERSION_2, "Unexpected file version %d", (int) header[1]);
+
+    // arch_version_major, arch_version_minor, head_size, head_count, tensor_count, data_alignment
+    uint32_t metadata[6];
+    ASSERT(fread(metadata, sizeof(metadata), 1, file) == 1, "Failed to read file metadata");
+    ASSERT(metadata[0] == expected_major && metadata[1] == expected_minor, "Unexpected architecture version %d.%d", (int) metadata[0], (int) metadata[1]);
+    ASSERT(metadata[2] * metadata[3] == (expected_major >= 5 ? header[3] : 0), "Unexpected head size %d and head count %d", (int) metadata[2], (int) metadata[3]);
+    ASSERT(metadata[4] > 0, "Tensor index is empty");
+    ASSERT(metadata[5] == 64, "Unexpected data alignment %d", (int) metadata[5]);
+
+    for (uint32_t i = 0; i < metadata[4]; i++) {
+        uint32_t entry_header[6];
+        ASSERT(fread(entry_header, sizeof(uint32_t) * 3, 1, file) == 1, "Failed to read tensor header");
+        ASSERT(entry_header[0] >= 1 && entry_header[0] <= 3, "Unexpected dimension count %d", (int) entry_header[0]);
+        ASSERT(fread(entry_header + 3, ENTRY_HEADER_SIZE(entry_header[0]) - sizeof(uint32_t) * 3, 1, file) == 1, "Failed to read tensor shape");
+        ASSERT(fseek(file, entry_header[1], SEEK_CUR) == 0, "Failed to skip tensor name");
+
+        uint64_t offset;
+        ASSERT(fread(&offset, sizeof(uint64_t), 1, file) == 1, "Failed to read tensor offset");
+        ASSERT(offset % metadata[5] == 0, "Tensor data at offset %llu is not aligned", (unsigned long long) offset);
+    }
+
+    fclose(file);
+
+    struct rwkv_init_params params = rwkv_get_default_init_params();
+    params.n_threads = 2;
+
+    struct rwkv_context * ctx = rwkv_init_from_file_with_params(quantized_file_name, &params);
+    ASSERT(ctx != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    float * logits = calloc(rwkv_get_logits_len(ctx), sizeof(float));
+    ASSERT(logits != NULL, "Failed to allocate logits");
+
+    ASSERT(rwkv_eval(ctx, '"', NULL, NULL, logits), "rwkv_eval failed");
+
+    rwkv_free(ctx);
+    free(logits);
+
+    // A tensor count larger than the file can hold is rejected before the index is allocated.
+    file = fopen(quantized_file_name, "r+b");
+    ASSERT(file != NULL, "Failed to open %s", quantized_file_name);
+
+    const uint32_t tensor_count = UINT32_MAX;
+    ASSERT(fseek(file, sizeof(header) + sizeof(uint32_t) * 4, SEEK_SET) == 0, "Failed to seek to tensor count");
+    ASSERT(fwrite(&tensor_count, sizeof(uint32_t), 1, file) == 1, "Failed to write tensor count");
+
+    fclose(file);
+
+    ASSERT(rwkv_init_from_file_with_params(quantized_file_name, &params) == NULL, "Tensor count %u was accepted", (unsigned) tensor_count);
+    ASSERT(rwkv_get_last_error(NULL) & RWKV_ERROR_FILE, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    remove(quantized_file_name);
+}
+
+int main(void) {
+    // Silences the overly verbose output during quantization.
+    rwkv_set_print_errors(NULL, false);
+
+    const uint32_t majors[TINY_RWKV_VERSION_COUNT] = { 4, 5, 5, 6, 7 };
+    const uint32_t minors[TINY_RWKV_VERSION_COUNT] = { 0, 1, 2, 0, 0 };
+
+    for (int i = 0; i < TINY_RWKV_VERSION_COUNT; i++) {
+        test_model(tiny_rwkv_versions[i], majors[i], minors[i]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,176 @@
+// Tests collection of importance matrices and quantization with them.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <rwkv.h>
+
+#include "assertions.inc"
+#include "tiny_rwkv_versions.inc"
+
+#define TOKEN_COUNT 24
+
+#define IMATRIX_FILE_NAME "tiny-rwkv.imatrix"
+
+static unsigned char * read_file(const char * file_name, long * size) {
+    FILE * file = fopen(file_name, "rb");
+    ASSERT(file != NULL, "Failed to open %s", file_name);
+
+    ASSERT(fseek(file, 0, SEEK_END) == 0, "Failed to seek in %s", file_name);
+    *size = ftell(file);
+    ASSERT(fseek(file, 0, SEEK_SET) == 0, "Failed to seek in %s", file_name);
+
+    unsigned char * data = malloc(*size);
+    ASSERT(data != NULL, "Failed to allocate %ld bytes", *size);
+    ASSERT(fread(data, *size, 1, file) == 1, "Failed to read %s", file_name);
+
+    fclose(file);
+
+    return data;
+}
+
+// Checks that the importance matrix of ffn.key of the first layer has statistics of all evaluated tokens.
+static void check_imatrix(const size_t n_embed) {
+    FILE * file = fopen(IMATRIX_FILE_NAME, "rb");
+    ASSERT(file != NULL, "Failed to open %s", IMATRIX_FILE_NAME);
+
+    uint32_t header[3];
+    ASSERT(fread(header, sizeof(header), 1, file) == 1, "Failed to read importance matrix header");
+    ASSERT(header[0] == 0x78746d69, "Invalid magic %08X", header[0]);
+    ASSERT(header[1] == 1, "Invalid version %d", (int) header[1]);
+
+    int found = 0;
+
+    for (uint32_t i = 0; i < header[2]; i++) {
+        uint32_t sizes[2];
+        uint64_t activation_count;
+        char name[128];
+
+        ASSERT(fread(sizes, sizeof(sizes), 1, file) == 1, "Failed to read entry header");
+        ASSERT(fread(&activation_count, sizeof(uint64_t), 1, file) == 1, "Failed to read activation count");
+        ASSERT(sizes[0] < sizeof(name), "Tensor name is too long");
+        ASSERT(fread(name, sizes[0], 1, file) == 1, "Failed to read tensor name");
+        name[sizes[0]] = 0;
+
+        float * values = malloc(sizes[1] * sizeof(float));
+        ASSERT(values != NULL, "Failed to allocate values");
+        ASSERT(fread(values, sizes[1] * sizeof(float), 1, file) == 1, "Failed to read values of %s", name);
+
+        float sum = 0.0F;
+
+        for (uint32_t j = 0; j < sizes[1]; j++) {
+            ASSERT(isfinite(values[j]) && values[j] >= 0.0F, "Invalid value %f of %s", (double) values[j], name);
+            sum += values[j];
+        }
+
+        ASSERT(sum > 0.0F, "All values of %s are zero", name);
+
+        if (strcmp(name, "blocks.0.ffn.key.weight") == 0) {
+            ASSERT(sizes[1] == n_embed, "%s has %d values instead of %d", name, (int) sizes[1], (int) n_embed);
+            ASSERT(activation_count == TOKEN_COUNT, "%s has %d activations instead of %d", name, (int) activation_count, TOKEN_COUNT);
+            found = 1;
+        }
+
+        free(values);
+    }
+
+    ASSERT(found, "No importance matrix of blocks.0.ffn.key.weight");
+
+    fclose(file);
+}
+
+void test_model(const char * version) {
+    char source_file_name[128];
+    char plain_file_name[128];
+    char imatrix_file_name[128];
+    snprintf(source_file_name, sizeof(source_file_name), "tiny-rwkv-%s-FP32.bin", version);
+    snprintf(plain_file_name, sizeof(plain_file_name), "tiny-rwkv-%s-FP32-Q4_0-plain.bin", version);
+    snprintf(imatrix_file_name, sizeof(imatrix_file_name), "tiny-rwkv-%s-FP32-Q4_0-imatrix.bin", version);
+
+    fprintf(stderr, "Testing %s\n", source_file_name);
+
+    struct rwkv_context * ctx = rwkv_init_from_file(source_file_name, 2, 0);
+    ASSERT(ctx != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    ASSERT(!rwkv_save_imatrix(ctx, IMATRIX_FILE_NAME), "Importance matrix was saved without collection");
+    ASSERT(rwkv_get_last_error(ctx) & RWKV_ERROR_ARGS, "Unexpected error");
+
+    uint32_t tokens[TOKEN_COUNT];
+
+    for (int i = 0; i < TOKEN_COUNT; i++) {
+        tokens[i] = (uint32_t) (i * 7 + 13) % 256;
+    }
+
+    float * logits = calloc(rwkv_get_logits_len(ctx), sizeof(float));
+    ASSERT(logits != NULL, "Failed to allocate logits");
+
+    ASSERT(rwkv_start_imatrix_collection(ctx), "rwkv_start_imatrix_collection failed");
+    ASSERT(rwkv_eval_sequence_in_chunks(ctx, tokens, TOKEN_COUNT, 8, NULL, NULL, logits), "rwkv_eval_sequence_in_chunks failed");
+    ASSERT(rwkv_save_imatrix(ctx, IMATRIX_FILE_NAME), "rwkv_save_imatrix failed");
+    rwkv_stop_imatrix_collection(ctx);
+
+    check_imatrix(rwkv_get_n_embed(ctx));
+
+    rwkv_free(ctx);
+
+    struct rwkv_quantize_params params = rwkv_get_default_quantize_params();
+
+    ASSERT(rwkv_quantize_model_file_with_params(source_file_name, plain_file_name, "Q4_0", &params), "Failed to quantize %s", source_file_name);
+
+    params.imatrix = IMATRIX_FILE_NAME;
+
+    ASSERT(rwkv_quantize_model_file_with_params(source_file_name, imatrix_file_name, "Q4_0", &params), "Failed to quantize %s", source_file_name);
+
+    long plain_size;
+    long imatrix_size;
+    unsigned char * plain_data = read_file(plain_file_name, &plain_size);
+    unsigned char * imatrix_data = read_file(imatrix_file_name, &imatrix_size);
+
+    ASSERT(plain_size == imatrix_size, "File sizes differ: %ld and %ld", plain_size, imatrix_size);
+    ASSERT(memcmp(plain_data, imatrix_data, plain_size) != 0, "Importance matrix did not change quantization");
+
+    free(imatrix_data);
+    free(plain_data);
+
+    ctx = rwkv_init_from_file(imatrix_file_name, 2, 0);
+    ASSERT(ctx != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    ASSERT(rwkv_eval_sequence_in_chunks(ctx, tokens, TOKEN_COUNT, 8, NULL, NULL, logits), "rwkv_eval_sequence_in_chunks failed");
+
+    for (size_t i = 0; i < rwkv_get_logits_len(ctx); i++) {
+        ASSERT(isfinite(logits[i]), "Logit %zu is not finite", i);
+    }
+
+    rwkv_free(ctx);
+    free(logits);
+
+    // A value count larger than the file can hold is rejected before the values are allocated.
+    FILE * file = fopen(IMATRIX_FILE_NAME, "r+b");
+    ASSERT(file != NULL, "Failed to open %s", IMATRIX_FILE_NAME);
+
+    const uint32_t value_count = UINT32_MAX;
+    ASSERT(fseek(file, sizeof(uint32_t) * 4, SEEK_SET) == 0, "Failed to seek to value count");
+    ASSERT(fwrite(&value_count, sizeof(uint32_t), 1, file) == 1, "Failed to write value count");
+
+    fclose(file);
+
+    ASSERT(!rwkv_quantize_model_file_with_params(source_file_name, imatrix_file_name, "Q4_0", &params), "Value count %u was accepted", (unsigned) value_count);
+    ASSERT(rwkv_get_last_error(NULL) & RWKV_ERROR_FILE, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    remove(imatrix_file_name);
+    remove(plain_file_name);
+    remove(IMATRIX_FILE_NAME);
+}
+
+int main(void) {
+    // Silences the overly verbose output during quantization.
+    rwkv_set_print_errors(NULL, false);
+
+    for (int i = 0; i < TINY_RWKV_VERSION_COUNT; i++) {
+        test_model(tiny_rwkv_versions[i]);
+    }
+
+    return 0;
+}
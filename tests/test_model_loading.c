@@ -0,0 +1,133 @@
+// Tests that models loaded with mmap or with parallel reading give results identical to models loaded by reading the file.
+// With mmap, tiny models are in an older file version and are copied from the mapping; quantized models are in the latest version,
+// where tensor data is aligned and used right from the mapping.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <rwkv.h>
+
+#include "assertions.inc"
+#include "tiny_rwkv_versions.inc"
+
+#define FORMAT_COUNT 3
+#define LOAD_MODE_COUNT 2
+
+struct load_mode {
+    const char * name;
+    bool use_mmap;
+    uint32_t n_load_threads;
+};
+
+static const struct load_mode load_modes[LOAD_MODE_COUNT] = {
+    { "mmap", true, 1 },
+    { "parallel reading", false, 4 }
+};
+
+static void eval_prompt(struct rwkv_context * ctx, float * state, float * logits) {
+    const char * prompt = "\"in";
+
+    rwkv_init_state(ctx, state);
+
+    for (size_t i = 0; prompt[i] != 0; i++) {
+        ASSERT(rwkv_eval(ctx, prompt[i], state, state, logits), "rwkv_eval failed");
+    }
+}
+
+void test_file(const char * file_name, const struct load_mode * mode) {
+    fprintf(stderr, "Testing %s with %s\n", file_name, mode->name);
+
+    struct rwkv_init_params params = rwkv_get_default_init_params();
+    params.n_threads = 2;
+
+    struct rwkv_context * ctx = rwkv_init_from_file_with_params(file_name, &params);
+
+    ASSERT(ctx != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    params.use_mmap = mode->use_mmap;
+    params.n_load_threads = mode->n_load_threads;
+
+    struct rwkv_context * mode_ctx = rwkv_init_from_file_with_params(file_name, &params);
+
+    ASSERT(mode_ctx != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    const size_t state_len = rwkv_get_state_len(ctx);
+    const size_t logits_len = rwkv_get_logits_len(ctx);
+
+    float * expected_state = calloc(state_len, sizeof(float));
+    float * expected_logits = calloc(logits_len, sizeof(float));
+    float * state = calloc(state_len, sizeof(float));
+    float * logits = calloc(logits_len, sizeof(float));
+
+    ASSERT(expected_state != NULL && state != NULL, "Failed to allocate state");
+    ASSERT(expected_logits != NULL && logits != NULL, "Failed to allocate logits");
+
+    eval_prompt(ctx, expected_state, expected_logits);
+    eval_prompt(mode_ctx, state, logits);
+
+    ASSERT(memcmp(expected_state, state, state_len * sizeof(float)) == 0, "States are not identical");
+    ASSERT(memcmp(expected_logits, logits, logits_len * sizeof(float)) == 0, "Logits are not identical");
+
+    rwkv_free(mode_ctx);
+    rwkv_free(ctx);
+
+    free(logits);
+    free(state);
+    free(expected_logits);
+    free(expected_state);
+}
+
+void test_model(const char * version, const char * format) {
+    char file_name[128];
+    snprintf(file_name, sizeof(file_name), "tiny-rwkv-%s-%s.bin", version, format);
+
+    for (int i = 0; i < LOAD_MODE_COUNT; i++) {
+        test_file(file_name, &load_modes[i]);
+    }
+}
+
+void test_aligned_model(const char * version) {
+    char source_file_name[128];
+    char quantized_file_name[128];
+    snprintf(source_file_name, sizeof(source_file_name), "tiny-rwkv-%s-FP32.bin", version);
+    snprintf(quantized_file_name, sizeof(quantized_file_name), "tiny-rwkv-%s-FP32-Q5_1-loading.bin", version);
+
+    ASSERT(rwkv_quantize_model_file(source_file_name, quantized_file_name, "Q5_1"), "Failed to quantize %s", source_file_name);
+
+    FILE * file = fopen(quantized_file_name, "rb");
+    ASSERT(file != NULL, "Failed to open %s", quantized_file_name);
+
+    uint32_t header[2];
+    ASSERT(fread(header, sizeof(header), 1, file) == 1, "Failed to read file header");
+    ASSERT(header[1] == RWKV_FILE_VERSION_2, "Unexpected file version %d", (int) header[1]);
+
+    fclose(file);
+
+    for (int i = 0; i < LOAD_MODE_COUNT; i++) {
+        test_file(quantized_file_name, &load_modes[i]);
+    }
+
+    remove(quantized_file_name);
+}
+
+int main(void) {
+    // Silences the overly verbose output during quantization.
+    rwkv_set_print_errors(NULL, false);
+
+    const char * formats[FORMAT_COUNT] = {
+        "FP32",
+        "FP16",
+        "Q5_1"
+    };
+
+    for (int i = 0; i < TINY_RWKV_VERSION_COUNT; i++) {
+        for (int j = 0; j < FORMAT_COUNT; j++) {
+            test_model(tiny_rwkv_versions[i], formats[j]);
+        }
+
+        test_aligned_model(tiny_rwkv_versions[i]);
+    }
+
+    return 0;
+}
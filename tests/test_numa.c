@@ -0,0 +1,106 @@
+// Tests that NUMA weight placement and contexts bound to NUMA nodes do not change logits.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <rwkv.h>
+
+#include "assertions.inc"
+#include "tiny_rwkv_versions.inc"
+
+#define SEQUENCE_LENGTH 4
+
+// Threads of contexts bound to a node may split matrix multiplications differently.
+#define MAX_DIFF 0.0001F
+
+static const uint32_t sequence[SEQUENCE_LENGTH] = { 1, 2, 3, 4 };
+
+static void eval_logits(struct rwkv_context * ctx, float * state, float * logits) {
+    ASSERT(rwkv_eval_sequence(ctx, sequence, SEQUENCE_LENGTH, NULL, state, NULL), "Unexpected error 0x%.8X", rwkv_get_last_error(ctx));
+    ASSERT(rwkv_eval(ctx, sequence[0], state, state, logits), "Unexpected error 0x%.8X", rwkv_get_last_error(ctx));
+}
+
+void test_model(const char * version) {
+    char file_name[128];
+    snprintf(file_name, sizeof(file_name), "tiny-rwkv-%s-FP32.bin", version);
+
+    fprintf(stderr, "Testing %s\n", file_name);
+
+    struct rwkv_init_params params = rwkv_get_default_init_params();
+    params.n_threads = 2;
+
+    ASSERT(params.numa_mode == RWKV_NUMA_NONE, "Unexpected default NUMA mode %d", (int) params.numa_mode);
+
+    struct rwkv_context * ctx = rwkv_init_from_file_with_params(file_name, &params);
+
+    ASSERT(ctx != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    const size_t state_len = rwkv_get_state_len(ctx);
+    const size_t logits_len = rwkv_get_logits_len(ctx);
+
+    float * state = calloc(state_len, sizeof(float));
+    float * expected_logits = calloc(logits_len, sizeof(float));
+    float * logits = calloc(logits_len, sizeof(float));
+
+    eval_logits(ctx, state, expected_logits);
+
+    rwkv_free(ctx);
+
+    const uint32_t node_count = rwkv_get_numa_node_count();
+
+    const enum rwkv_numa_mode modes[2] = { RWKV_NUMA_INTERLEAVE, RWKV_NUMA_REPLICATE };
+
+    for (int i = 0; i < 2; i++) {
+        params.numa_mode = modes[i];
+
+        ctx = rwkv_init_from_file_with_params(file_name, &params);
+
+        ASSERT(ctx != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+        eval_logits(ctx, state, logits);
+        ASSERT_MAX_ABS_DIFF(expected_logits, logits, logits_len, MAX_DIFF, modes[i] == RWKV_NUMA_INTERLEAVE ? "Interleaved" : "Replicated");
+
+        // Every node, including node 0 that holds the model itself.
+        for (uint32_t node = 0; node < node_count; node++) {
+            struct rwkv_context * node_ctx = rwkv_clone_context_on_numa_node(ctx, 2, node);
+
+            ASSERT(node_ctx != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+            eval_logits(node_ctx, state, logits);
+            ASSERT_MAX_ABS_DIFF(expected_logits, logits, logits_len, MAX_DIFF, "Context on node");
+
+            // Clones stay on the node.
+            struct rwkv_context * clone = rwkv_clone_context(node_ctx, 1);
+
+            ASSERT(clone != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+            eval_logits(clone, state, logits);
+            ASSERT_MAX_ABS_DIFF(expected_logits, logits, logits_len, MAX_DIFF, "Clone of context on node");
+
+            rwkv_free(clone);
+            rwkv_free(node_ctx);
+        }
+
+        ASSERT(rwkv_clone_context_on_numa_node(ctx, 2, node_count) == NULL, "Node %d was accepted", (int) node_count);
+
+        rwkv_free(ctx);
+    }
+
+    params.numa_mode = (enum rwkv_numa_mode) 100;
+    ASSERT(rwkv_init_from_file_with_params(file_name, &params) == NULL, "Invalid NUMA mode was accepted");
+
+    free(logits);
+    free(expected_logits);
+    free(state);
+}
+
+int main(void) {
+    fprintf(stderr, "NUMA nodes: %d\n", (int) rwkv_get_numa_node_count());
+
+    for (int i = 0; i < TINY_RWKV_VERSION_COUNT; i++) {
+        test_model(tiny_rwkv_versions[i]);
+    }
+
+    return 0;
+}
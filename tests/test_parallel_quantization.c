@@ -0,0 +1,71 @@
+// Tests that quantization with multiple threads produces the same file as quantization with one thread.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <rwkv.h>
+
+#include "assertions.inc"
+#include "tiny_rwkv_versions.inc"
+
+static unsigned char * read_file(const char * file_name, long * size) {
+    FILE * file = fopen(file_name, "rb");
+    ASSERT(file != NULL, "Failed to open %s", file_name);
+
+    ASSERT(fseek(file, 0, SEEK_END) == 0, "Failed to seek in %s", file_name);
+    *size = ftell(file);
+    ASSERT(fseek(file, 0, SEEK_SET) == 0, "Failed to seek in %s", file_name);
+
+    unsigned char * data = malloc(*size);
+    ASSERT(data != NULL, "Failed to allocate %ld bytes", *size);
+    ASSERT(fread(data, *size, 1, file) == 1, "Failed to read %s", file_name);
+
+    fclose(file);
+
+    return data;
+}
+
+void test_model(const char * version, const char * format) {
+    char source_file_name[128];
+    char serial_file_name[128];
+    char parallel_file_name[128];
+    snprintf(source_file_name, sizeof(source_file_name), "tiny-rwkv-%s-%s.bin", version, format);
+    snprintf(serial_file_name, sizeof(serial_file_name), "tiny-rwkv-%s-%s-Q5_1-serial.bin", version, format);
+    snprintf(parallel_file_name, sizeof(parallel_file_name), "tiny-rwkv-%s-%s-Q5_1-parallel.bin", version, format);
+
+    fprintf(stderr, "Testing %s\n", source_file_name);
+
+    struct rwkv_quantize_params params = rwkv_get_default_quantize_params();
+
+    ASSERT(rwkv_quantize_model_file_with_params(source_file_name, serial_file_name, "Q5_1", &params), "Failed to quantize %s", source_file_name);
+
+    params.n_threads = 4;
+
+    ASSERT(rwkv_quantize_model_file_with_params(source_file_name, parallel_file_name, "Q5_1", &params), "Failed to quantize %s", source_file_name);
+
+    long serial_size;
+    long parallel_size;
+    unsigned char * serial_data = read_file(serial_file_name, &serial_size);
+    unsigned char * parallel_data = read_file(parallel_file_name, &parallel_size);
+
+    ASSERT(serial_size == parallel_size, "File sizes differ: %ld and %ld", serial_size, parallel_size);
+    ASSERT(memcmp(serial_data, parallel_data, serial_size) == 0, "Files are not identical");
+
+    free(parallel_data);
+    free(serial_data);
+
+    remove(parallel_file_name);
+    remove(serial_file_name);
+}
+
+int main(void) {
+    // Silences the overly verbose output during quantization.
+    rwkv_set_print_errors(NULL, false);
+
+    for (int i = 0; i < TINY_RWKV_VERSION_COUNT; i++) {
+        test_model(tiny_rwkv_versions[i], "FP32");
+        test_model(tiny_rwkv_versions[i], "FP16");
+    }
+
+    return 0;
+}
@@ -0,0 +1,87 @@
+// Tests that rwkv_eval_sequence_cached reuses cached prefixes and gives results identical to chunked evaluation.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <rwkv.h>
+
+#include "assertions.inc"
+
+#define CHUNK_SIZE 4
+
+static void eval_and_compare(
+    struct rwkv_context * ctx,
+    struct rwkv_prefix_cache * cache,
+    const char * prompt,
+    const uint64_t expected_reused_tokens
+) {
+    const size_t prompt_length = strlen(prompt);
+    const size_t state_len = rwkv_get_state_len(ctx);
+    const size_t logits_len = rwkv_get_logits_len(ctx);
+
+    uint32_t * tokens = calloc(prompt_length, sizeof(uint32_t));
+    float * expected_state = calloc(state_len, sizeof(float));
+    float * expected_logits = calloc(logits_len, sizeof(float));
+    float * state = calloc(state_len, sizeof(float));
+    float * logits = calloc(logits_len, sizeof(float));
+
+    ASSERT(tokens != NULL, "Failed to allocate tokens");
+    ASSERT(expected_state != NULL && state != NULL, "Failed to allocate state");
+    ASSERT(expected_logits != NULL && logits != NULL, "Failed to allocate logits");
+
+    for (size_t i = 0; i < prompt_length; i++) {
+        tokens[i] = prompt[i];
+    }
+
+    ASSERT(rwkv_eval_sequence_in_chunks(ctx, tokens, prompt_length, CHUNK_SIZE, NULL, expected_state, expected_logits), "rwkv_eval_sequence_in_chunks failed");
+
+    uint64_t reused_before;
+    rwkv_get_prefix_cache_stats(cache, &reused_before, NULL, NULL);
+
+    ASSERT(rwkv_eval_sequence_cached(ctx, cache, tokens, prompt_length, state, logits), "rwkv_eval_sequence_cached failed");
+
+    uint64_t reused_after;
+    rwkv_get_prefix_cache_stats(cache, &reused_after, NULL, NULL);
+
+    fprintf(stderr, "Prompt \"%s\": reused %d tokens\n", prompt, (int) (reused_after - reused_before));
+
+    ASSERT(reused_after - reused_before == expected_reused_tokens, "Expected %d reused tokens", (int) expected_reused_tokens);
+    ASSERT(memcmp(expected_state, state, state_len * sizeof(float)) == 0, "States are not identical");
+    ASSERT(memcmp(expected_logits, logits, logits_len * sizeof(float)) == 0, "Logits are not identical");
+
+    free(logits);
+    free(state);
+    free(expected_logits);
+    free(expected_state);
+    free(tokens);
+}
+
+int main(void) {
+    struct rwkv_context * ctx = rwkv_init_from_file("tiny-rwkv-5v2-730K-FP32.bin", 2, 0);
+
+    ASSERT(ctx != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    const size_t state_size = rwkv_get_state_len(ctx) * sizeof(float);
+
+    // Enough memory for a bit more than 4 chunks.
+    struct rwkv_prefix_cache * cache = rwkv_create_prefix_cache(ctx, state_size * 4 + state_size / 2, CHUNK_SIZE);
+
+    ASSERT(cache != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    eval_and_compare(ctx, cache, "You are a helpful bot. Hi", 0);
+    // The last full chunk is not reused, because at least one token must be evaluated to get logits.
+    eval_and_compare(ctx, cache, "You are a helpful bot. Hi", 16);
+    eval_and_compare(ctx, cache, "You are a helpful bot. Hello", 16);
+    eval_and_compare(ctx, cache, "You are kind", 8);
+    eval_and_compare(ctx, cache, "Tell me a joke", 0);
+
+    size_t used_memory;
+    rwkv_get_prefix_cache_stats(cache, NULL, NULL, &used_memory);
+
+    ASSERT(used_memory <= state_size * 4 + state_size / 2, "Memory budget exceeded: %d bytes", (int) used_memory);
+
+    rwkv_free_prefix_cache(cache);
+    rwkv_free(ctx);
+
+    return 0;
+}
@@ -0,0 +1,139 @@
+// Tests that a quantization policy assigns per-tensor data types, and that models with mixed types can be loaded.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <rwkv.h>
+
+#include "assertions.inc"
+#include "tiny_rwkv_versions.inc"
+
+// Values of data types in the model file.
+#define TYPE_FP32 0
+#define TYPE_FP16 1
+#define TYPE_Q5_1 8
+#define TYPE_Q8_0 9
+#define TYPE_Q4_K 13
+
+// Elements in a block of K-quants.
+#define QK_K 256
+
+// Rows of att.output are as long as the embedding, which is too short for K-quants in most test models.
+#define POLICY "ffn.key=Q8_0, head=Q8_0, @last:1=FP16, att.output=Q4_K"
+
+// Returns the expected type of the tensor, or -1 if the test does not check it.
+static int expected_type(const char * name, const int last_layer) {
+    char last_layer_name[64];
+    snprintf(last_layer_name, sizeof(last_layer_name), "blocks.%d.ffn.value.weight", last_layer);
+
+    if (strcmp(name, "emb.weight") == 0 || strcmp(name, "blocks.0.ln1.weight") == 0) {
+        return TYPE_FP32;
+    }
+
+    if (strcmp(name, "head.weight") == 0 || strcmp(name, "blocks.0.ffn.key.weight") == 0) {
+        return TYPE_Q8_0;
+    }
+
+    if (strcmp(name, "blocks.0.ffn.value.weight") == 0) {
+        return TYPE_Q5_1;
+    }
+
+    if (strcmp(name, last_layer_name) == 0) {
+        return TYPE_FP16;
+    }
+
+    return -1;
+}
+
+void test_model(const char * version) {
+    char source_file_name[128];
+    char quantized_file_name[128];
+    snprintf(source_file_name, sizeof(source_file_name), "tiny-rwkv-%s-FP32.bin", version);
+    snprintf(quantized_file_name, sizeof(quantized_file_name), "tiny-rwkv-%s-FP32-mixed.bin", version);
+
+    fprintf(stderr, "Testing %s\n", quantized_file_name);
+
+    struct rwkv_quantize_params params = rwkv_get_default_quantize_params();
+    params.policy = POLICY;
+
+    ASSERT(rwkv_quantize_model_file_with_params(source_file_name, quantized_file_name, "Q5_1", &params), "Failed to quantize %s", source_file_name);
+
+    FILE * file = fopen(quantized_file_name, "rb");
+    ASSERT(file != NULL, "Failed to open %s", quantized_file_name);
+
+    uint32_t header[6];
+    uint32_t metadata[6];
+    ASSERT(fread(header, sizeof(header), 1, file) == 1, "Failed to read file header");
+    ASSERT(fread(metadata, sizeof(metadata), 1, file) == 1, "Failed to read file metadata");
+
+    const int last_layer = (int) header[4] - 1;
+    int checked_count = 0;
+
+    for (uint32_t i = 0; i < metadata[4]; i++) {
+        uint32_t entry_header[6];
+        char name[128];
+        uint64_t offset;
+
+        ASSERT(fread(entry_header, sizeof(uint32_t) * 3, 1, file) == 1, "Failed to read tensor header");
+        ASSERT(fread(entry_header + 3, sizeof(uint32_t) * entry_header[0], 1, file) == 1, "Failed to read tensor shape");
+        ASSERT(entry_header[1] < sizeof(name), "Tensor name is too long");
+        ASSERT(fread(name, entry_header[1], 1, file) == 1, "Failed to read tensor name");
+        ASSERT(fread(&offset, sizeof(uint64_t), 1, file) == 1, "Failed to read tensor offset");
+
+        name[entry_header[1]] = 0;
+
+        int expected = expected_type(name, last_layer);
+
+        // Rows that can not be split into K-quant blocks fall back to the base type.
+        if (strcmp(name, "blocks.0.att.output.weight") == 0) {
+            expected = entry_header[3] % QK_K == 0 ? TYPE_Q4_K : TYPE_Q5_1;
+        }
+
+        if (expected >= 0) {
+            ASSERT((int) entry_header[2] == expected, "Tensor %s has type %d instead of %d", name, (int) entry_header[2], expected);
+            checked_count++;
+        }
+    }
+
+    fclose(file);
+
+    ASSERT(checked_count == 7, "Found %d of 7 checked tensors", checked_count);
+
+    struct rwkv_context * ctx = rwkv_init_from_file(quantized_file_name, 2, 0);
+    ASSERT(ctx != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    const size_t logits_len = rwkv_get_logits_len(ctx);
+    float * logits = calloc(logits_len, sizeof(float));
+    ASSERT(logits != NULL, "Failed to allocate logits");
+
+    ASSERT(rwkv_eval(ctx, '"', NULL, NULL, logits), "rwkv_eval failed");
+
+    for (size_t i = 0; i < logits_len; i++) {
+        ASSERT(isfinite(logits[i]), "Logit %zu is not finite", i);
+    }
+
+    rwkv_free(ctx);
+    free(logits);
+    remove(quantized_file_name);
+}
+
+int main(void) {
+    // Silences the overly verbose output during quantization.
+    rwkv_set_print_errors(NULL, false);
+
+    for (int i = 0; i < TINY_RWKV_VERSION_COUNT; i++) {
+        test_model(tiny_rwkv_versions[i]);
+    }
+
+    struct rwkv_quantize_params params = rwkv_get_default_quantize_params();
+    params.policy = "ffn.key=Q9_9";
+
+    ASSERT(!rwkv_quantize_model_file_with_params("tiny-rwkv-5v2-730K-FP32.bin", "tiny-rwkv-invalid-policy.bin", "Q5_1", &params), "Invalid policy was accepted");
+    ASSERT(rwkv_get_last_error(NULL) & RWKV_ERROR_ARGS, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    remove("tiny-rwkv-invalid-policy.bin");
+
+    return 0;
+}
@@ -0,0 +1,141 @@
+// Tests that rwkv_sampler follows its parameters and that rwkv_eval_and_sample samples from the same logits as rwkv_eval_in_state.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <rwkv.h>
+
+#include "assertions.inc"
+#include "tiny_rwkv_versions.inc"
+
+#define TOKEN_COUNT 8
+
+static uint32_t argmax(const float * logits, const size_t length) {
+    uint32_t best = 0;
+
+    for (size_t i = 1; i < length; i++) {
+        if (logits[i] > logits[best]) {
+            best = (uint32_t) i;
+        }
+    }
+
+    return best;
+}
+
+// Returns the count of logits greater than the logit of the token.
+static size_t rank(const float * logits, const size_t length, const uint32_t token) {
+    size_t count = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        count += logits[i] > logits[token] ? 1 : 0;
+    }
+
+    return count;
+}
+
+void test_model(const char * version) {
+    char file_name[128];
+    snprintf(file_name, sizeof(file_name), "tiny-rwkv-%s-FP32.bin", version);
+
+    fprintf(stderr, "Testing %s\n", file_name);
+
+    struct rwkv_context * ctx = rwkv_init_from_file(file_name, 2, 0);
+
+    ASSERT(ctx != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    const size_t logits_len = rwkv_get_logits_len(ctx);
+
+    float * logits = calloc(logits_len, sizeof(float));
+
+    ASSERT(logits != NULL, "Failed to allocate logits");
+
+    struct rwkv_state * state = rwkv_create_state(ctx);
+    struct rwkv_state * expected_state = rwkv_create_state(ctx);
+
+    ASSERT(state != NULL && expected_state != NULL, "rwkv_create_state failed with error 0x%.8X", rwkv_get_last_error(ctx));
+
+    // Greedy sampling picks the most likely token.
+    struct rwkv_sampler_params params = rwkv_get_default_sampler_params();
+    params.temperature = 0.0F;
+
+    struct rwkv_sampler * sampler = rwkv_create_sampler(ctx, &params);
+
+    ASSERT(sampler != NULL, "rwkv_create_sampler failed with error 0x%.8X", rwkv_get_last_error(NULL));
+
+    ASSERT(rwkv_eval_in_state(ctx, '"', expected_state, logits), "rwkv_eval_in_state failed");
+    ASSERT(rwkv_sampler_sample(sampler, logits) == argmax(logits, logits_len), "Greedy sampling did not pick the most likely token");
+
+    // A logit bias of -INFINITY bans a token.
+    const uint32_t banned = argmax(logits, logits_len);
+    const float ban = -INFINITY;
+    ASSERT(rwkv_sampler_set_logit_bias(sampler, &banned, &ban, 1), "rwkv_sampler_set_logit_bias failed");
+    ASSERT(rwkv_sampler_sample(sampler, logits) != banned, "Banned token was sampled");
+
+    const uint32_t out_of_range = (uint32_t) logits_len;
+    ASSERT(!rwkv_sampler_set_logit_bias(sampler, &out_of_range, &ban, 1), "Out of range token was accepted");
+
+    rwkv_free_sampler(sampler);
+
+    // Top-k keeps only the k most likely tokens.
+    params = rwkv_get_default_sampler_params();
+    params.top_k = 3;
+
+    sampler = rwkv_create_sampler(ctx, &params);
+
+    ASSERT(sampler != NULL, "rwkv_create_sampler failed with error 0x%.8X", rwkv_get_last_error(NULL));
+
+    for (int i = 0; i < 100; i++) {
+        ASSERT(rank(logits, logits_len, rwkv_sampler_sample(sampler, logits)) < 3, "Top-k sampled an unlikely token");
+    }
+
+    rwkv_free_sampler(sampler);
+
+    // Invalid parameters are rejected.
+    params = rwkv_get_default_sampler_params();
+    params.top_p = 0.0F;
+
+    ASSERT(rwkv_create_sampler(ctx, &params) == NULL, "Invalid top_p was accepted");
+
+    // Evaluation with sampling gives the same tokens as evaluation followed by sampling with an identical sampler.
+    params = rwkv_get_default_sampler_params();
+    params.top_p = 0.9F;
+    params.temperature = 0.8F;
+    params.presence_penalty = 0.5F;
+    params.seed = 42;
+
+    sampler = rwkv_create_sampler(ctx, &params);
+    struct rwkv_sampler * expected_sampler = rwkv_create_sampler(ctx, &params);
+
+    ASSERT(sampler != NULL && expected_sampler != NULL, "rwkv_create_sampler failed with error 0x%.8X", rwkv_get_last_error(NULL));
+
+    ASSERT(rwkv_reset_state(ctx, state), "rwkv_reset_state failed");
+    ASSERT(rwkv_reset_state(ctx, expected_state), "rwkv_reset_state failed");
+
+    uint32_t token = '"';
+    uint32_t expected_token = '"';
+
+    for (int i = 0; i < TOKEN_COUNT; i++) {
+        ASSERT(rwkv_eval_in_state(ctx, expected_token, expected_state, logits), "rwkv_eval_in_state failed");
+        expected_token = rwkv_sampler_sample(expected_sampler, logits);
+
+        ASSERT(rwkv_eval_and_sample(ctx, token, state, sampler, &token), "rwkv_eval_and_sample failed");
+        ASSERT(token == expected_token, "Sampled tokens are not identical");
+    }
+
+    rwkv_free_sampler(expected_sampler);
+    rwkv_free_sampler(sampler);
+    rwkv_free_state(expected_state);
+    rwkv_free_state(state);
+    rwkv_free(ctx);
+
+    free(logits);
+}
+
+int main(void) {
+    for (int i = 0; i < TINY_RWKV_VERSION_COUNT; i++) {
+        test_model(tiny_rwkv_versions[i]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+// Tests sequence graph caching and sequence length bucketing.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <rwkv.h>
+
+#include "assertions.inc"
+
+#define PROMPT_LENGTH 13
+
+// Bucketing evaluates the sequence with graphs of different lengths, which may accumulate in a different order.
+#define MAX_DIFF 0.0001F
+
+static void assert_stats(struct rwkv_context * ctx, const uint64_t expected_hits, const uint64_t expected_misses) {
+    uint64_t hits;
+    uint64_t misses;
+    rwkv_get_sequence_graph_cache_stats(ctx, &hits, &misses);
+
+    ASSERT(hits == expected_hits, "Expected %d hits, got %d", (int) expected_hits, (int) hits);
+    ASSERT(misses == expected_misses, "Expected %d misses, got %d", (int) expected_misses, (int) misses);
+}
+
+int main(void) {
+    struct rwkv_context * ctx = rwkv_init_from_file("tiny-rwkv-5v2-730K-FP32.bin", 2, 0);
+
+    ASSERT(ctx != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    const char prompt[PROMPT_LENGTH + 1] = "Hello, world!";
+
+    uint32_t tokens[PROMPT_LENGTH];
+
+    for (int i = 0; i < PROMPT_LENGTH; i++) {
+        tokens[i] = prompt[i];
+    }
+
+    const size_t state_len = rwkv_get_state_len(ctx);
+    const size_t logits_len = rwkv_get_logits_len(ctx);
+
+    float * expected_state = calloc(state_len, sizeof(float));
+    float * expected_logits = calloc(logits_len, sizeof(float));
+    float * state = calloc(state_len, sizeof(float));
+    float * logits = calloc(logits_len, sizeof(float));
+
+    ASSERT(expected_state != NULL && state != NULL, "Failed to allocate state");
+    ASSERT(expected_logits != NULL && logits != NULL, "Failed to allocate logits");
+
+    assert_stats(ctx, 0, 0);
+
+    // ---
+
+    rwkv_set_sequence_graph_cache_size(ctx, 2);
+
+    ASSERT(rwkv_eval_sequence(ctx, tokens, PROMPT_LENGTH, NULL, expected_state, expected_logits), "rwkv_eval_sequence failed");
+    assert_stats(ctx, 0, 1);
+
+    ASSERT(rwkv_eval_sequence(ctx, tokens, 4, NULL, state, NULL), "rwkv_eval_sequence failed");
+    assert_stats(ctx, 0, 2);
+
+    ASSERT(rwkv_eval_sequence(ctx, tokens, PROMPT_LENGTH, NULL, state, logits), "rwkv_eval_sequence failed");
+    assert_stats(ctx, 1, 2);
+
+    ASSERT(memcmp(expected_state, state, state_len * sizeof(float)) == 0, "Cached graph gave different results");
+
+    // Evicts the graph of length 4, which is the least recently used one.
+    ASSERT(rwkv_eval_sequence(ctx, tokens, 8, NULL, state, NULL), "rwkv_eval_sequence failed");
+    assert_stats(ctx, 1, 3);
+
+    ASSERT(rwkv_eval_sequence(ctx, tokens, PROMPT_LENGTH, NULL, state, NULL), "rwkv_eval_sequence failed");
+    assert_stats(ctx, 2, 3);
+
+    ASSERT(rwkv_eval_sequence(ctx, tokens, 4, NULL, state, NULL), "rwkv_eval_sequence failed");
+    assert_stats(ctx, 2, 4);
+
+    // ---
+
+    // 13 = 8 + 4 + 1, where the last part is evaluated by the serial graph.
+    rwkv_set_sequence_graph_cache_size(ctx, 4);
+    rwkv_set_sequence_length_bucketing(ctx, true);
+
+    ASSERT(rwkv_eval_sequence(ctx, tokens, PROMPT_LENGTH, NULL, state, logits), "rwkv_eval_sequence failed");
+    assert_stats(ctx, 3, 5);
+
+    float state_diff = max_abs_diff(expected_state, state, state_len);
+    float logits_diff = max_abs_diff(expected_logits, logits, logits_len);
+
+    fprintf(stderr, "Bucketing: max state difference %f, max logit difference %f\n", (double) state_diff, (double) logits_diff);
+
+    ASSERT(state_diff <= MAX_DIFF, "Too big state difference %f", (double) state_diff);
+    ASSERT(logits_diff <= MAX_DIFF, "Too big logit difference %f", (double) logits_diff);
+
+    // ---
+
+    rwkv_free(ctx);
+
+    free(logits);
+    free(state);
+    free(expected_logits);
+    free(expected_state);
+
+    return 0;
+}
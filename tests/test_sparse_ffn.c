@@ -0,0 +1,102 @@
+// Tests that skipping zero FFN activations gives results equivalent to the dense FFN.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <rwkv.h>
+
+#include "assertions.inc"
+#include "tiny_rwkv_versions.inc"
+
+#define FORMAT_COUNT 3
+
+// The sparse path accumulates in a different order, and for FP16 and quantized models it multiplies
+// activations in FP32 by an FP16 copy of the weights, while the dense path converts activations to the type of the weights.
+#define MAX_DIFF_FP32 0.001F
+#define MAX_DIFF_QUANTIZED 0.05F
+
+static void eval_prompt(struct rwkv_context * ctx, float * state, float * logits) {
+    const char * prompt = "\"in";
+
+    rwkv_init_state(ctx, state);
+
+    for (size_t i = 0; prompt[i] != 0; i++) {
+        ASSERT(rwkv_eval(ctx, prompt[i], state, state, logits), "rwkv_eval failed");
+    }
+}
+
+void test_model(const char * version, const char * format) {
+    char file_name[128];
+    snprintf(file_name, sizeof(file_name), "tiny-rwkv-%s-%s.bin", version, format);
+
+    fprintf(stderr, "Testing %s\n", file_name);
+
+    struct rwkv_init_params params = rwkv_get_default_init_params();
+    params.n_threads = 2;
+
+    struct rwkv_context * ctx = rwkv_init_from_file_with_params(file_name, &params);
+
+    ASSERT(ctx != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    params.sparse_ffn = true;
+
+    struct rwkv_context * sparse_ctx = rwkv_init_from_file_with_params(file_name, &params);
+
+    ASSERT(sparse_ctx != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    const size_t state_len = rwkv_get_state_len(ctx);
+    const size_t logits_len = rwkv_get_logits_len(ctx);
+
+    float * expected_state = calloc(state_len, sizeof(float));
+    float * expected_logits = calloc(logits_len, sizeof(float));
+    float * state = calloc(state_len, sizeof(float));
+    float * logits = calloc(logits_len, sizeof(float));
+
+    ASSERT(expected_state != NULL && state != NULL, "Failed to allocate state");
+    ASSERT(expected_logits != NULL && logits != NULL, "Failed to allocate logits");
+
+    const float max_diff = strcmp(format, "FP32") == 0 ? MAX_DIFF_FP32 : MAX_DIFF_QUANTIZED;
+
+    eval_prompt(ctx, expected_state, expected_logits);
+    eval_prompt(sparse_ctx, state, logits);
+
+    float diff = max_abs_diff(expected_state, state, state_len);
+    ASSERT(diff <= max_diff, "States differ by %f", (double) diff);
+
+    diff = max_abs_diff(expected_logits, logits, logits_len);
+    ASSERT(diff <= max_diff, "Logits differ by %f", (double) diff);
+
+    // Sequences use the dense FFN even when the model has the transposed weights.
+    const uint32_t sequence[3] = { '"', 'i', 'n' };
+
+    ASSERT(rwkv_eval_sequence(ctx, sequence, 3, NULL, expected_state, expected_logits), "rwkv_eval_sequence failed");
+    ASSERT(rwkv_eval_sequence(sparse_ctx, sequence, 3, NULL, state, logits), "rwkv_eval_sequence failed");
+
+    ASSERT(memcmp(expected_state, state, state_len * sizeof(float)) == 0, "States are not identical");
+    ASSERT(memcmp(expected_logits, logits, logits_len * sizeof(float)) == 0, "Logits are not identical");
+
+    rwkv_free(sparse_ctx);
+    rwkv_free(ctx);
+
+    free(logits);
+    free(state);
+    free(expected_logits);
+    free(expected_state);
+}
+
+int main(void) {
+    const char * formats[FORMAT_COUNT] = {
+        "FP32",
+        "FP16",
+        "Q5_1"
+    };
+
+    for (int i = 0; i < TINY_RWKV_VERSION_COUNT; i++) {
+        for (int j = 0; j < FORMAT_COUNT; j++) {
+            test_model(tiny_rwkv_versions[i], formats[j]);
+        }
+    }
+
+    return 0;
+}
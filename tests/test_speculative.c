@@ -0,0 +1,166 @@
+// Tests that greedy speculative decoding emits the same tokens as greedy decoding with the target model alone,
+// and that statistics of the decoder are consistent.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <rwkv.h>
+
+#include "assertions.inc"
+#include "tiny_rwkv_versions.inc"
+
+#define PROMPT_LENGTH 4
+#define GENERATED_COUNT 12
+#define DRAFT_LENGTH 4
+
+static uint32_t argmax(const float * logits, const size_t length) {
+    uint32_t best = 0;
+
+    for (size_t i = 1; i < length; i++) {
+        if (logits[i] > logits[best]) {
+            best = (uint32_t) i;
+        }
+    }
+
+    return best;
+}
+
+// Generates GENERATED_COUNT tokens after the prompt.
+static void generate(struct rwkv_speculative_decoder * decoder, struct rwkv_sampler * sampler, uint32_t * tokens) {
+    const uint32_t prompt[PROMPT_LENGTH] = { '"', 'h', 'e', 'y' };
+
+    rwkv_speculative_reset(decoder);
+    ASSERT(rwkv_speculative_feed(decoder, prompt, PROMPT_LENGTH), "rwkv_speculative_feed failed");
+
+    size_t count = 0;
+
+    while (count < GENERATED_COUNT) {
+        size_t emitted = 0;
+
+        ASSERT(rwkv_speculative_decode(decoder, sampler, tokens + count, GENERATED_COUNT - count, &emitted), "rwkv_speculative_decode failed");
+        ASSERT(emitted >= 1 && emitted <= DRAFT_LENGTH + 1, "Unexpected emitted token count %d", (int) emitted);
+
+        count += emitted;
+    }
+
+    ASSERT(count == GENERATED_COUNT, "More tokens than requested were emitted");
+}
+
+void test_model(const char * version) {
+    char target_file_name[128];
+    char draft_file_name[128];
+    snprintf(target_file_name, sizeof(target_file_name), "tiny-rwkv-%s-FP32.bin", version);
+    snprintf(draft_file_name, sizeof(draft_file_name), "tiny-rwkv-%s-Q5_1.bin", version);
+
+    fprintf(stderr, "Testing %s with draft %s\n", target_file_name, draft_file_name);
+
+    struct rwkv_context * target = rwkv_init_from_file(target_file_name, 2, 0);
+    struct rwkv_context * draft = rwkv_init_from_file(draft_file_name, 2, 0);
+
+    ASSERT(target != NULL && draft != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    const size_t state_len = rwkv_get_state_len(target);
+    const size_t logits_len = rwkv_get_logits_len(target);
+
+    float * state = calloc(state_len, sizeof(float));
+    float * logits = calloc(logits_len, sizeof(float));
+
+    ASSERT(state != NULL && logits != NULL, "Failed to allocate buffers");
+
+    const uint32_t prompt[PROMPT_LENGTH] = { '"', 'h', 'e', 'y' };
+    uint32_t expected_tokens[GENERATED_COUNT];
+
+    ASSERT(rwkv_eval_sequence(target, prompt, PROMPT_LENGTH, NULL, state, logits), "rwkv_eval_sequence failed");
+
+    for (int i = 0; i < GENERATED_COUNT; i++) {
+        expected_tokens[i] = argmax(logits, logits_len);
+
+        ASSERT(rwkv_eval(target, expected_tokens[i], state, state, logits), "rwkv_eval failed");
+    }
+
+    rwkv_set_sequence_graph_cache_size(target, DRAFT_LENGTH + 1);
+
+    struct rwkv_speculative_decoder * decoder = rwkv_create_speculative_decoder(target, draft, DRAFT_LENGTH);
+
+    ASSERT(decoder != NULL, "rwkv_create_speculative_decoder failed with error 0x%.8X", rwkv_get_last_error(NULL));
+
+    struct rwkv_sampler_params params = rwkv_get_default_sampler_params();
+    params.temperature = 0.0F;
+
+    struct rwkv_sampler * sampler = rwkv_create_sampler(target, &params);
+
+    ASSERT(sampler != NULL, "rwkv_create_sampler failed with error 0x%.8X", rwkv_get_last_error(NULL));
+
+    uint32_t tokens[GENERATED_COUNT];
+
+    generate(decoder, sampler, tokens);
+
+    for (int i = 0; i < GENERATED_COUNT; i++) {
+        ASSERT(tokens[i] == expected_tokens[i], "Token %d is %d, expected %d", i, (int) tokens[i], (int) expected_tokens[i]);
+    }
+
+    rwkv_free_sampler(sampler);
+
+    // Sampled tokens are not compared, only checked to be in range.
+    params.temperature = 0.8F;
+    params.top_p = 0.9F;
+
+    sampler = rwkv_create_sampler(target, &params);
+
+    ASSERT(sampler != NULL, "rwkv_create_sampler failed with error 0x%.8X", rwkv_get_last_error(NULL));
+
+    generate(decoder, sampler, tokens);
+
+    for (int i = 0; i < GENERATED_COUNT; i++) {
+        ASSERT(tokens[i] < logits_len, "Token %d is out of range", i);
+    }
+
+    uint64_t rounds;
+    uint64_t drafted_tokens;
+    uint64_t accepted_tokens;
+    uint64_t generated_tokens;
+    rwkv_get_speculative_stats(decoder, &rounds, &drafted_tokens, &accepted_tokens, &generated_tokens);
+
+    ASSERT(generated_tokens == 2 * GENERATED_COUNT, "Generated token count is %d", (int) generated_tokens);
+    ASSERT(generated_tokens == rounds + accepted_tokens, "Each round must emit its accepted tokens and one more token");
+    ASSERT(accepted_tokens <= drafted_tokens, "More tokens were accepted than drafted");
+
+    uint64_t by_position[DRAFT_LENGTH];
+    ASSERT(rwkv_get_speculative_acceptance_by_position(decoder, by_position, DRAFT_LENGTH) == DRAFT_LENGTH, "Unexpected position count");
+
+    uint64_t accepted_sum = 0;
+
+    for (int i = 0; i < DRAFT_LENGTH; i++) {
+        ASSERT(i == 0 || by_position[i] <= by_position[i - 1], "Acceptance count increases at position %d", i);
+
+        accepted_sum += by_position[i];
+    }
+
+    ASSERT(accepted_sum == accepted_tokens, "Acceptance counts by position do not add up");
+
+    rwkv_reset_speculative_stats(decoder);
+    rwkv_get_speculative_stats(decoder, &rounds, NULL, NULL, NULL);
+    ASSERT(rounds == 0, "Statistics were not reset");
+
+    size_t emitted;
+    rwkv_speculative_reset(decoder);
+    ASSERT(!rwkv_speculative_decode(decoder, sampler, tokens, GENERATED_COUNT, &emitted), "Decoding without fed tokens was accepted");
+
+    rwkv_free_sampler(sampler);
+    rwkv_free_speculative_decoder(decoder);
+
+    rwkv_free(draft);
+    rwkv_free(target);
+
+    free(logits);
+    free(state);
+}
+
+int main(void) {
+    for (int i = 0; i < TINY_RWKV_VERSION_COUNT; i++) {
+        test_model(tiny_rwkv_versions[i]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+// Tests that states survive compression round trips with small effect on logits.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <rwkv.h>
+
+#include "logit_difference_validator.inc"
+#include "tiny_rwkv_versions.inc"
+
+#define COMPRESSION_COUNT 2
+
+// Checks that every element of an INT8 round trip is within half of its block scale from the original.
+// The compressed state starts with FP32 scales of blocks, followed by a byte per element.
+static void check_int8_error(const float * original, const float * state, const size_t state_len, const void * compressed_state, const size_t compressed_size) {
+    const size_t block_count = (compressed_size - state_len) / sizeof(float);
+    const size_t block_size = state_len / block_count;
+
+    ASSERT(block_count * (sizeof(float) + block_size) == compressed_size, "Unexpected INT8 layout of %zd bytes", compressed_size);
+
+    for (size_t b = 0; b < block_count; b++) {
+        float scale;
+        memcpy(&scale, (const char *) compressed_state + b * sizeof(float), sizeof(float));
+
+        // Slack for rounding of the scaled value itself.
+        const float max_error = scale * 0.5001F;
+        const float error = max_abs_diff(original + b * block_size, state + b * block_size, block_size);
+
+        ASSERT(error <= max_error, "Too big error %g in block %zd with scale %g", (double) error, b, (double) scale);
+    }
+}
+
+void test_compression(const char * version, const enum rwkv_state_compression compression, const float max_diff) {
+    char file_name[128];
+    snprintf(file_name, sizeof(file_name), "tiny-rwkv-%s-FP32.bin", version);
+
+    fprintf(stderr, "Testing %s with compression %d\n", file_name, (int) compression);
+
+    float expected_logits[N_VOCAB];
+    load_expected_logits(expected_logits, version);
+
+    struct rwkv_context * ctx = rwkv_init_from_file(file_name, N_THREADS, N_GPU_LAYERS);
+
+    ASSERT(ctx != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    const size_t state_len = rwkv_get_state_len(ctx);
+    const size_t compressed_size = rwkv_get_compressed_state_size(ctx, compression);
+
+    ASSERT(compressed_size > 0, "Unexpected compressed state size");
+    ASSERT(compressed_size <= state_len * sizeof(float) / 2, "Compressed state is too big: %zd bytes", compressed_size);
+
+    float * state = calloc(state_len, sizeof(float));
+    float * original = calloc(state_len, sizeof(float));
+    float * logits = calloc(N_VOCAB, sizeof(float));
+    void * compressed_state = malloc(compressed_size);
+
+    ASSERT(state != NULL && original != NULL, "Failed to allocate state");
+    ASSERT(logits != NULL, "Failed to allocate logits");
+    ASSERT(compressed_state != NULL, "Failed to allocate compressed state");
+
+    // Same prompt as in logit_difference_validator.inc, but with a round trip before each token, including the initial state.
+    const char * prompt = "\"in";
+
+    rwkv_init_state(ctx, state);
+
+    for (size_t i = 0; prompt[i] != 0; i++) {
+        memcpy(original, state, state_len * sizeof(float));
+
+        ASSERT(rwkv_compress_state(ctx, state, compression, compressed_state), "rwkv_compress_state failed");
+        ASSERT(rwkv_decompress_state(ctx, compressed_state, compression, state), "rwkv_decompress_state failed");
+
+        if (compression == RWKV_STATE_COMPRESSION_INT8) {
+            check_int8_error(original, state, state_len, compressed_state, compressed_size);
+        }
+
+        ASSERT(rwkv_eval(ctx, prompt[i], state, state, logits), "rwkv_eval failed");
+    }
+
+    float diff = max_abs_diff(expected_logits, logits, N_VOCAB);
+
+    fprintf(stderr, "Max logit difference: %f\n", (double) diff);
+
+    ASSERT(diff <= max_diff, "Too big logit difference %f, expected no more than %f", (double) diff, (double) max_diff);
+
+    rwkv_free(ctx);
+
+    free(compressed_state);
+    free(logits);
+    free(original);
+    free(state);
+}
+
+int main(void) {
+    const enum rwkv_state_compression compressions[COMPRESSION_COUNT] = {
+        RWKV_STATE_COMPRESSION_FP16,
+        RWKV_STATE_COMPRESSION_INT8
+    };
+
+    // About twice the largest difference measured on the test models: 0.0035 for FP16 and 0.044 for INT8, both on v5.1.
+    const float max_diffs[COMPRESSION_COUNT] = {
+        0.01F,
+        0.1F
+    };
+
+    for (int i = 0; i < TINY_RWKV_VERSION_COUNT; i++) {
+        for (int j = 0; j < COMPRESSION_COUNT; j++) {
+            test_compression(tiny_rwkv_versions[i], compressions[j], max_diffs[j]);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,119 @@
+// Tests that every SIMD kernel of INT8 state compression that the CPU supports computes exactly the same as the scalar kernel,
+// including block sizes that are not multiples of the vector width, unaligned buffers, zero blocks and the huge values of v4 states.
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include <vector>
+
+#include "ggml.h"
+#include "ggml-cpu.h"
+
+#include "assertions.inc"
+
+#include "../rwkv_operators_simd.inc"
+#include "../rwkv_state_compression_int8.inc"
+
+#define SIZE_COUNT 6
+
+// Block sizes are head sizes for v5+ and embedding sizes for v4; most have a remainder after full vectors.
+static const size_t sizes[SIZE_COUNT] = { 1, 7, 20, 33, 64, 100 };
+
+struct kernel {
+    const char * name;
+    rwkv_quantize_state_block_int8_fn quantize;
+    rwkv_dequantize_state_block_int8_fn dequantize;
+};
+
+static uint32_t random_state = 42;
+
+// Returns a deterministic pseudo-random value in [min, max).
+static float random_float(const float min, const float max) {
+    random_state = random_state * 1664525 + 1013904223;
+
+    return min + (max - min) * (float) (random_state >> 8) / (float) (1 << 24);
+}
+
+// Buffers start an element after an allocation, so that SIMD loads and stores are not aligned to the vector width.
+template<typename T>
+struct buffer {
+    std::vector<T> storage;
+
+    explicit buffer(const size_t length) : storage(length + 1) {}
+
+    T * data() {
+        return storage.data() + 1;
+    }
+};
+
+static void test_block(const struct kernel & kernel, const float * x, const size_t n, const char * name) {
+    buffer<int8_t> expected_values(n);
+    buffer<int8_t> actual_values(n);
+    buffer<float> expected_y(n);
+    buffer<float> actual_y(n);
+
+    const float expected_scale = rwkv_quantize_state_block_int8_scalar(x, expected_values.data(), n);
+    const float actual_scale = kernel.quantize(x, actual_values.data(), n);
+
+    ASSERT(actual_scale == expected_scale, "%s: scale %f instead of %f", name, (double) actual_scale, (double) expected_scale);
+    ASSERT(memcmp(expected_values.data(), actual_values.data(), n) == 0, "%s: quantized values differ", name);
+
+    rwkv_dequantize_state_block_int8_scalar(expected_values.data(), expected_scale, expected_y.data(), n);
+    kernel.dequantize(expected_values.data(), expected_scale, actual_y.data(), n);
+
+    ASSERT(memcmp(expected_y.data(), actual_y.data(), n * sizeof(float)) == 0, "%s: dequantized values differ", name);
+}
+
+static void test_kernel(const struct kernel & kernel, const size_t n) {
+    fprintf(stderr, "Testing %s with block size %d\n", kernel.name, (int) n);
+
+    buffer<float> x(n);
+
+    for (size_t i = 0; i < n; i++) {
+        x.data()[i] = random_float(-4.0F, 4.0F);
+    }
+
+    test_block(kernel, x.data(), n, "Random block");
+
+    // The element with the largest magnitude is quantized to exactly -127.
+    x.data()[n / 2] = -10.0F;
+    test_block(kernel, x.data(), n, "Block with an extreme value");
+
+    memset(x.data(), 0, n * sizeof(float));
+    test_block(kernel, x.data(), n, "Zero block");
+
+    // Initial att_pp of v4.
+    for (size_t i = 0; i < n; i++) {
+        x.data()[i] = -1e30F;
+    }
+
+    test_block(kernel, x.data(), n, "Block of -1e30");
+}
+
+int main(void) {
+    std::vector<struct kernel> kernels;
+
+#if defined(RWKV_SIMD_X86)
+    if (ggml_cpu_has_avx2()) {
+        kernels.push_back({ "AVX2", rwkv_quantize_state_block_int8_avx2, rwkv_dequantize_state_block_int8_avx2 });
+    } else {
+        fprintf(stderr, "Skipping AVX2, not supported by the CPU\n");
+    }
+#elif defined(RWKV_SIMD_NEON)
+    if (ggml_cpu_has_neon()) {
+        kernels.push_back({ "NEON", rwkv_quantize_state_block_int8_neon, rwkv_dequantize_state_block_int8_neon });
+    } else {
+        fprintf(stderr, "Skipping NEON, not supported by the CPU\n");
+    }
+#endif
+
+    for (const struct kernel & kernel : kernels) {
+        for (int i = 0; i < SIZE_COUNT; i++) {
+            test_kernel(kernel, sizes[i]);
+        }
+    }
+
+    return 0;
+}
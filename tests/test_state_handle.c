@@ -0,0 +1,96 @@
+// Tests that evaluation with rwkv_state handles gives results identical to evaluation with host buffers.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <rwkv.h>
+
+#include "assertions.inc"
+#include "tiny_rwkv_versions.inc"
+
+#define TOKEN_COUNT 6
+
+void test_model(const char * version) {
+    char file_name[128];
+    snprintf(file_name, sizeof(file_name), "tiny-rwkv-%s-FP32.bin", version);
+
+    fprintf(stderr, "Testing %s\n", file_name);
+
+    struct rwkv_context * ctx = rwkv_init_from_file(file_name, 2, 0);
+
+    ASSERT(ctx != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    const size_t state_len = rwkv_get_state_len(ctx);
+    const size_t logits_len = rwkv_get_logits_len(ctx);
+
+    const char prompt[TOKEN_COUNT + 1] = "hello!";
+
+    uint32_t tokens[TOKEN_COUNT];
+
+    for (int i = 0; i < TOKEN_COUNT; i++) {
+        tokens[i] = prompt[i];
+    }
+
+    float * expected_state = calloc(state_len, sizeof(float));
+    float * expected_logits = calloc(logits_len, sizeof(float));
+    float * state_data = calloc(state_len, sizeof(float));
+    float * logits = calloc(logits_len, sizeof(float));
+
+    ASSERT(expected_state != NULL && state_data != NULL, "Failed to allocate state");
+    ASSERT(expected_logits != NULL && logits != NULL, "Failed to allocate logits");
+
+    struct rwkv_state * state = rwkv_create_state(ctx);
+
+    ASSERT(state != NULL, "rwkv_create_state failed with error 0x%.8X", rwkv_get_last_error(ctx));
+
+    // A new state must be equal to the initial state.
+    rwkv_init_state(ctx, expected_state);
+    ASSERT(rwkv_export_state(ctx, state, state_data), "rwkv_export_state failed");
+    ASSERT(memcmp(expected_state, state_data, state_len * sizeof(float)) == 0, "New state is not the initial state");
+
+    // Serial mode, interleaved with host buffer evaluation that uses the same graph.
+    for (int i = 0; i < TOKEN_COUNT; i++) {
+        ASSERT(rwkv_eval(ctx, tokens[i], i == 0 ? NULL : expected_state, expected_state, expected_logits), "rwkv_eval failed");
+        ASSERT(rwkv_eval_in_state(ctx, tokens[i], state, logits), "rwkv_eval_in_state failed");
+    }
+
+    ASSERT(rwkv_export_state(ctx, state, state_data), "rwkv_export_state failed");
+    ASSERT(memcmp(expected_state, state_data, state_len * sizeof(float)) == 0, "Serial mode states are not identical");
+    ASSERT(memcmp(expected_logits, logits, logits_len * sizeof(float)) == 0, "Serial mode logits are not identical");
+
+    // Sequence mode.
+    ASSERT(rwkv_eval_sequence(ctx, tokens, TOKEN_COUNT, NULL, expected_state, expected_logits), "rwkv_eval_sequence failed");
+
+    ASSERT(rwkv_reset_state(ctx, state), "rwkv_reset_state failed");
+    ASSERT(rwkv_eval_sequence_in_state(ctx, tokens, TOKEN_COUNT, state, logits), "rwkv_eval_sequence_in_state failed");
+
+    ASSERT(rwkv_export_state(ctx, state, state_data), "rwkv_export_state failed");
+    ASSERT(memcmp(expected_state, state_data, state_len * sizeof(float)) == 0, "Sequence mode states are not identical");
+    ASSERT(memcmp(expected_logits, logits, logits_len * sizeof(float)) == 0, "Sequence mode logits are not identical");
+
+    // Import continues from the given state.
+    ASSERT(rwkv_eval(ctx, tokens[0], expected_state, expected_state, expected_logits), "rwkv_eval failed");
+
+    ASSERT(rwkv_import_state(ctx, state, state_data), "rwkv_import_state failed");
+    ASSERT(rwkv_eval_in_state(ctx, tokens[0], state, logits), "rwkv_eval_in_state failed");
+
+    ASSERT(rwkv_export_state(ctx, state, state_data), "rwkv_export_state failed");
+    ASSERT(memcmp(expected_state, state_data, state_len * sizeof(float)) == 0, "Imported states are not identical");
+    ASSERT(memcmp(expected_logits, logits, logits_len * sizeof(float)) == 0, "Imported logits are not identical");
+
+    rwkv_free_state(state);
+    rwkv_free(ctx);
+
+    free(logits);
+    free(state_data);
+    free(expected_logits);
+    free(expected_state);
+}
+
+int main(void) {
+    for (int i = 0; i < TINY_RWKV_VERSION_COUNT; i++) {
+        test_model(tiny_rwkv_versions[i]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+// Tests that contexts attached to a thread pool, including clones and pinned threads, compute the same logits as without a pool.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <rwkv.h>
+
+#include "assertions.inc"
+#include "tiny_rwkv_versions.inc"
+
+#define SEQUENCE_LENGTH 5
+
+// Thread count changes how matrix multiplications are split, but not what they compute.
+#define MAX_DIFF 0.0001F
+
+static const uint32_t sequence[SEQUENCE_LENGTH] = { 1, 2, 3, 4, 5 };
+
+static void eval_with(struct rwkv_context * ctx, float * state, float * logits) {
+    ASSERT(rwkv_eval_sequence(ctx, sequence, SEQUENCE_LENGTH, NULL, state, NULL), "Unexpected error 0x%.8X", rwkv_get_last_error(ctx));
+    ASSERT(rwkv_eval(ctx, sequence[0], state, state, logits), "Unexpected error 0x%.8X", rwkv_get_last_error(ctx));
+}
+
+void test_model(const char * version) {
+    char file_name[128];
+    snprintf(file_name, sizeof(file_name), "tiny-rwkv-%s-FP32.bin", version);
+
+    fprintf(stderr, "Testing %s\n", file_name);
+
+    struct rwkv_context * ctx = rwkv_init_from_file(file_name, 2, 0);
+
+    ASSERT(ctx != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    const size_t state_len = rwkv_get_state_len(ctx);
+    const size_t logits_len = rwkv_get_logits_len(ctx);
+
+    float * state = calloc(state_len, sizeof(float));
+    float * expected_logits = calloc(logits_len, sizeof(float));
+    float * logits = calloc(logits_len, sizeof(float));
+
+    eval_with(ctx, state, expected_logits);
+
+    struct rwkv_thread_pool_params params = rwkv_get_default_thread_pool_params();
+    ASSERT(params.n_threads > 0, "Default thread count is 0");
+
+    // The context asks for more threads than the pool has.
+    params.n_threads = 1;
+
+    struct rwkv_thread_pool * pool = rwkv_create_thread_pool(&params);
+    ASSERT(pool != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    ASSERT(rwkv_set_thread_pool(ctx, pool), "Unexpected error 0x%.8X", rwkv_get_last_error(ctx));
+    eval_with(ctx, state, logits);
+    ASSERT_MAX_ABS_DIFF(expected_logits, logits, logits_len, MAX_DIFF, "Pooled context");
+
+    struct rwkv_context * clone = rwkv_clone_context(ctx, 4);
+    ASSERT(clone != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    eval_with(clone, state, logits);
+    ASSERT_MAX_ABS_DIFF(expected_logits, logits, logits_len, MAX_DIFF, "Pooled clone");
+
+    uint64_t computations = 0;
+    uint64_t waits = 0;
+    rwkv_get_thread_pool_stats(pool, &computations, &waits);
+
+    // Each eval_with computes at least two graphs.
+    ASSERT(computations >= 4, "Expected at least 4 computations, got %d", (int) computations);
+    ASSERT(waits == 0, "Sequential computations waited %d times", (int) waits);
+
+    ASSERT(rwkv_set_thread_pool(ctx, NULL), "Unexpected error 0x%.8X", rwkv_get_last_error(ctx));
+    ASSERT(rwkv_set_thread_pool(clone, NULL), "Unexpected error 0x%.8X", rwkv_get_last_error(clone));
+    rwkv_free_thread_pool(pool);
+
+    eval_with(clone, state, logits);
+    ASSERT_MAX_ABS_DIFF(expected_logits, logits, logits_len, MAX_DIFF, "Detached clone");
+
+    params.pin_threads = true;
+    params.first_core = 0;
+
+    pool = rwkv_create_thread_pool(&params);
+    ASSERT(pool != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    ASSERT(rwkv_set_thread_pool(ctx, pool), "Unexpected error 0x%.8X", rwkv_get_last_error(ctx));
+    eval_with(ctx, state, logits);
+    ASSERT_MAX_ABS_DIFF(expected_logits, logits, logits_len, MAX_DIFF, "Pinned context");
+
+    // A context freed while attached returns its threads to the pool.
+    struct rwkv_context * pinned_clone = rwkv_clone_context(ctx, 1);
+    ASSERT(pinned_clone != NULL, "Unexpected error 0x%.8X", rwkv_get_last_error(NULL));
+
+    eval_with(pinned_clone, state, logits);
+    ASSERT_MAX_ABS_DIFF(expected_logits, logits, logits_len, MAX_DIFF, "Pinned clone");
+
+    rwkv_free(pinned_clone);
+
+    ASSERT(rwkv_set_thread_pool(ctx, NULL), "Unexpected error 0x%.8X", rwkv_get_last_error(ctx));
+    rwkv_free_thread_pool(pool);
+
+    params.n_threads = 0;
+    ASSERT(rwkv_create_thread_pool(&params) == NULL, "Thread count 0 was accepted");
+
+    params.n_threads = 1;
+    params.first_core = 1000000;
+    ASSERT(rwkv_create_thread_pool(&params) == NULL, "Core 1000000 was accepted");
+
+    rwkv_free(clone);
+    rwkv_free(ctx);
+
+    free(logits);
+    free(expected_logits);
+    free(state);
+}
+
+int main(void) {
+    for (int i = 0; i < TINY_RWKV_VERSION_COUNT; i++) {
+        test_model(tiny_rwkv_versions[i]);
+    }
+
+    return 0;
+}
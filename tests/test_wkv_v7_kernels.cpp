@@ -0,0 +1,147 @@
+// Tests that every SIMD kernel of the wkv v7 operator that the CPU supports computes the same as the scalar kernel,
+// including head sizes that are not multiples of the vector width, unaligned buffers, row ranges and in-place state updates.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "ggml.h"
+#include "ggml-cpu.h"
+
+#include "assertions.inc"
+
+#include "../rwkv_operators_simd.inc"
+#include "../rwkv_operators_wkv_v7.inc"
+
+// Kernels only reorder sums and fuse multiplications with additions.
+#define MAX_DIFF 0.0001F
+
+#define SIZE_COUNT 5
+
+// Each head size has a remainder after full vectors of AVX2, AVX-512 or NEON, except 64.
+static const size_t sizes[SIZE_COUNT] = { 1, 7, 20, 33, 64 };
+
+struct kernel {
+    const char * name;
+    rwkv_wkv_v7_head_fn fn;
+};
+
+static uint32_t random_state = 42;
+
+// Returns a deterministic pseudo-random value in [min, max).
+static float random_float(const float min, const float max) {
+    random_state = random_state * 1664525 + 1013904223;
+
+    return min + (max - min) * (float) (random_state >> 8) / (float) (1 << 24);
+}
+
+// Buffers start a float after an allocation, so that SIMD loads and stores are not aligned to the vector width.
+struct buffer {
+    std::vector<float> storage;
+
+    explicit buffer(const size_t length, const float min = 0.0F, const float max = 0.0F) : storage(length + 1) {
+        for (size_t i = 0; i < length; i++) {
+            storage[i + 1] = random_float(min, max);
+        }
+    }
+
+    float * data() {
+        return storage.data() + 1;
+    }
+};
+
+static void test_kernel(const struct kernel & kernel, const size_t S) {
+    fprintf(stderr, "Testing %s with head size %d\n", kernel.name, (int) S);
+
+    buffer state(S * S, -1.0F, 1.0F);
+    buffer r(S, -1.0F, 1.0F);
+    // Decay is in (0, 1) in the model.
+    buffer w(S, 0.0F, 1.0F);
+    buffer k(S, -1.0F, 1.0F);
+    buffer v(S, -1.0F, 1.0F);
+    buffer a(S, -1.0F, 1.0F);
+    buffer b(S, -1.0F, 1.0F);
+
+    // Rows of the whole head, then a range of rows that starts in the middle of the head.
+    const size_t row_begins[2] = { 0, S / 2 };
+
+    for (const size_t row_begin : row_begins) {
+        const size_t row_count = S - row_begin;
+
+        struct rwkv_wkv_v7_head_args args;
+        args.S = S;
+        args.row_count = row_count;
+        args.state_in = state.data() + row_begin * S;
+        args.r = r.data();
+        args.w = w.data();
+        args.k = k.data();
+        args.v = v.data() + row_begin;
+        args.a = a.data();
+        args.b = b.data();
+
+        buffer expected_state(row_count * S);
+        buffer expected_y(row_count);
+
+        args.state_out = expected_state.data();
+        args.y = expected_y.data();
+        rwkv_wkv_v7_head_scalar(args);
+
+        buffer actual_state(row_count * S);
+        buffer actual_y(row_count);
+
+        args.state_out = actual_state.data();
+        args.y = actual_y.data();
+        kernel.fn(args);
+
+        ASSERT_MAX_ABS_DIFF(expected_state.data(), actual_state.data(), row_count * S, MAX_DIFF, "State");
+        ASSERT_MAX_ABS_DIFF(expected_y.data(), actual_y.data(), row_count, MAX_DIFF, "Output");
+
+        // The serial graph updates the state in place.
+        buffer in_place_state(row_count * S);
+        memcpy(in_place_state.data(), state.data() + row_begin * S, row_count * S * sizeof(float));
+
+        args.state_in = in_place_state.data();
+        args.state_out = in_place_state.data();
+        args.y = actual_y.data();
+        kernel.fn(args);
+
+        ASSERT_MAX_ABS_DIFF(expected_state.data(), in_place_state.data(), row_count * S, MAX_DIFF, "In-place state");
+        ASSERT_MAX_ABS_DIFF(expected_y.data(), actual_y.data(), row_count, MAX_DIFF, "In-place output");
+    }
+}
+
+int main(void) {
+    // The scalar kernel is tested too, because updating in place must not change its results either.
+    std::vector<struct kernel> kernels = { { "scalar", rwkv_wkv_v7_head_scalar } };
+
+#if defined(RWKV_SIMD_X86)
+    if (ggml_cpu_has_avx2() && ggml_cpu_has_fma()) {
+        kernels.push_back({ "AVX2", rwkv_wkv_v7_head_avx2 });
+    } else {
+        fprintf(stderr, "Skipping AVX2, not supported by the CPU\n");
+    }
+
+    if (ggml_cpu_has_avx512()) {
+        kernels.push_back({ "AVX-512", rwkv_wkv_v7_head_avx512 });
+    } else {
+        fprintf(stderr, "Skipping AVX-512, not supported by the CPU\n");
+    }
+#elif defined(RWKV_SIMD_NEON)
+    if (ggml_cpu_has_neon()) {
+        kernels.push_back({ "NEON", rwkv_wkv_v7_head_neon });
+    } else {
+        fprintf(stderr, "Skipping NEON, not supported by the CPU\n");
+    }
+#endif
+
+    for (const struct kernel & kernel : kernels) {
+        for (int i = 0; i < SIZE_COUNT; i++) {
+            test_kernel(kernel, sizes[i]);
+        }
+    }
+
+    return 0;
+}